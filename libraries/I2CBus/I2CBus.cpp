@@ -0,0 +1,177 @@
+/* I2CBus.cpp
+common I2C transaction layer for the drivers of a board
+*/
+
+#include "I2CBus.h"
+
+I2CBus I2C;
+
+I2CBus::I2CBus(void)
+{
+  // can't use wire here, since wire is not initialized yet
+  _sclPin = I2C_NO_PIN;
+  _sdaPin = I2C_NO_PIN;
+  _muxResetPin = I2C_NO_PIN;
+  _consecutiveErrors = 0;
+  _recoveryCount = 0;
+  _onError = 0;
+  _onRecovery = 0;
+  clearErrorCounts();
+}
+
+// start I2C on the given pins and release the multiplexer from reset, muxResetPin may be I2C_NO_PIN
+void I2CBus::begin( int8_t sclPin, int8_t sdaPin, int8_t muxResetPin )
+{
+  _sclPin = sclPin;
+  _sdaPin = sdaPin;
+  _muxResetPin = muxResetPin;
+  if (_muxResetPin != I2C_NO_PIN)  {
+    pinMode(_muxResetPin, OUTPUT);
+    digitalWrite(_muxResetPin, HIGH);
+  }
+  Wire.beginOnPins(_sclPin, _sdaPin);
+}
+
+// write length bytes (register address first) to a device, retried up to I2C_MAX_ATTEMPTS times
+boolean I2CBus::write( uint8_t device, uint8_t address, const uint8_t *data, uint8_t length )
+{
+  for (uint8_t attempt = 0; attempt < I2C_MAX_ATTEMPTS; attempt++)  {
+    if (transfer(address, data, length, 0, 0))  {
+      reportSuccess(device, attempt);
+      return true;
+    }
+  }
+  reportFailure(device, address, (length > 0) ? data[0] : 0);
+  return false;
+}
+
+// read length bytes starting at register reg, retried up to I2C_MAX_ATTEMPTS times. data is only written on success
+boolean I2CBus::read( uint8_t device, uint8_t address, uint8_t reg, uint8_t *data, uint8_t length )
+{
+  for (uint8_t attempt = 0; attempt < I2C_MAX_ATTEMPTS; attempt++)  {
+    if (transfer(address, &reg, 1, data, length))  {
+      reportSuccess(device, attempt);
+      return true;
+    }
+  }
+  reportFailure(device, address, reg);
+  return false;
+}
+
+// read once without retry or error accounting, for scanning devices that may not be there
+boolean I2CBus::probe( uint8_t address, uint8_t reg, uint8_t *data, uint8_t length )
+{
+  return transfer(address, &reg, 1, data, length);
+}
+
+// one attempt: write the bytes, then read rxLength bytes if rxLength > 0
+boolean I2CBus::transfer( uint8_t address, const uint8_t *data, uint8_t length, uint8_t *rxData, uint8_t rxLength )
+{
+  Wire.beginTransmission(address);
+  for (uint8_t i = 0; i < length; i++)  {
+    Wire.write(data[i]);
+  }
+  if (Wire.endTransmission() != 0)  return false;     // address or data NACK
+  if (rxLength == 0)  return true;
+
+  if (rxLength > I2C_MAX_READ_LENGTH)  return false;
+  uint8_t rxBuffer[I2C_MAX_READ_LENGTH];
+  Wire.requestFrom(address, rxLength);
+  uint8_t received = 0;
+  while (Wire.available())  {       // drain everything, a short read must not leave bytes for the next transaction
+    uint8_t b = Wire.read();
+    if (received < rxLength)  rxBuffer[received] = b;
+    received++;
+  }
+  if (received != rxLength)  return false;
+  for (uint8_t i = 0; i < rxLength; i++)  {
+    rxData[i] = rxBuffer[i];
+  }
+  return true;
+}
+
+// the sketch is told about failed transactions and recoveries, e.g. to log or trace them
+void I2CBus::setCallbacks( i2cErrorCallback_t onError, i2cRecoveryCallback_t onRecovery )
+{
+  _onError = onError;
+  _onRecovery = onRecovery;
+}
+
+void I2CBus::reportSuccess( uint8_t device, uint8_t attempt )
+{
+  _consecutiveErrors = 0;
+  if ((attempt > 0) && (device < I2C_MAX_DEVICES) && (_retryCount[device] < 0xFFFF))  _retryCount[device]++;
+}
+
+// count the failed transaction and recover the bus if the errors keep coming
+void I2CBus::reportFailure( uint8_t device, uint8_t address, uint8_t reg )
+{
+  if ((device < I2C_MAX_DEVICES) && (_errorCount[device] < 0xFFFF))  _errorCount[device]++;
+  if (_onError)  _onError(device, address, reg);
+
+  _consecutiveErrors++;
+  if (_consecutiveErrors >= I2C_RECOVERY_THRESHOLD)  {
+    recover();
+    _consecutiveErrors = 0;
+  }
+}
+
+// A slave that was interrupted in the middle of a read can hold SDA low forever. Stop the I2C peripheral,
+// which owns SCL and SDA while it is enabled, clock SCL by hand until the slave lets go, send a STOP,
+// pulse the multiplexer reset and restart the I2C peripheral.
+// The multiplexer forgets its channel selection; drivers compare getRecoveryCount() to notice.
+void I2CBus::recover( void )
+{
+  if ((_sclPin != I2C_NO_PIN) && (_sdaPin != I2C_NO_PIN))  {
+    Wire.end();
+    pinMode(_sdaPin, INPUT);
+    pinMode(_sclPin, OUTPUT);
+    for (uint8_t i = 0; (i < I2C_RECOVERY_CLOCKS) && (digitalRead(_sdaPin) == LOW); i++)  {
+      digitalWrite(_sclPin, LOW);
+      delayMicroseconds(I2C_RECOVERY_HALF_PERIOD);
+      digitalWrite(_sclPin, HIGH);
+      delayMicroseconds(I2C_RECOVERY_HALF_PERIOD);
+    }
+    // STOP: SDA rises while SCL is high
+    digitalWrite(_sclPin, LOW);
+    pinMode(_sdaPin, OUTPUT);
+    digitalWrite(_sdaPin, LOW);
+    delayMicroseconds(I2C_RECOVERY_HALF_PERIOD);
+    digitalWrite(_sclPin, HIGH);
+    delayMicroseconds(I2C_RECOVERY_HALF_PERIOD);
+    digitalWrite(_sdaPin, HIGH);
+    delayMicroseconds(I2C_RECOVERY_HALF_PERIOD);
+  }
+  if (_muxResetPin != I2C_NO_PIN)  {
+    digitalWrite(_muxResetPin, LOW);
+    delayMicroseconds(I2C_RECOVERY_HALF_PERIOD);
+    digitalWrite(_muxResetPin, HIGH);
+  }
+  if (_sclPin != I2C_NO_PIN)  Wire.beginOnPins(_sclPin, _sdaPin);
+
+  _recoveryCount++;
+  if (_onRecovery)  _onRecovery(_recoveryCount);
+}
+
+uint16_t I2CBus::getErrorCount( uint8_t device )
+{
+  return (device < I2C_MAX_DEVICES) ? _errorCount[device] : 0;
+}
+
+uint16_t I2CBus::getRetryCount( uint8_t device )
+{
+  return (device < I2C_MAX_DEVICES) ? _retryCount[device] : 0;
+}
+
+uint16_t I2CBus::getRecoveryCount( void )
+{
+  return _recoveryCount;
+}
+
+void I2CBus::clearErrorCounts( void )
+{
+  for (uint8_t i = 0; i < I2C_MAX_DEVICES; i++)  {
+    _errorCount[i] = 0;
+    _retryCount[i] = 0;
+  }
+}
@@ -0,0 +1,61 @@
+/* I2CBus.h
+common I2C transaction layer for the drivers of a board: bounded retries, per-device error counters and bus recovery.
+The board numbers its devices 0 .. I2C_MAX_DEVICES - 1, each one has its own error counter.
+Failed transactions and recoveries can be reported to the sketch, e.g. to trace them.
+*/
+
+#ifndef _I2C_BUS_H_
+#define _I2C_BUS_H_
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define I2C_MAX_ATTEMPTS           3      // tries per transaction before it is reported as failed
+#define I2C_RECOVERY_THRESHOLD     2      // consecutive failed transactions before the bus is recovered
+#define I2C_RECOVERY_CLOCKS        9      // SCL pulses to make a slave release SDA in the middle of a byte
+#define I2C_RECOVERY_HALF_PERIOD   5      // us, ~100 kHz
+#define I2C_MAX_READ_LENGTH        12     // bytes per read transaction, e.g. fuel gauge VCELL through CONFIG in one burst
+#define I2C_MAX_DEVICES            8      // error counters, device numbers are 0 .. I2C_MAX_DEVICES - 1
+#define I2C_NO_PIN                 -1
+
+// a transaction to address failed I2C_MAX_ATTEMPTS times, reg is the register address
+typedef void (*i2cErrorCallback_t)( uint8_t device, uint8_t address, uint8_t reg );
+// the bus was recovered, the multiplexer (if any) was reset
+typedef void (*i2cRecoveryCallback_t)( uint16_t recoveryCount );
+
+class I2CBus
+{
+  public:
+    I2CBus();
+
+    void      begin( int8_t sclPin, int8_t sdaPin, int8_t muxResetPin );
+    boolean   write( uint8_t device, uint8_t address, const uint8_t *data, uint8_t length );
+    boolean   read( uint8_t device, uint8_t address, uint8_t reg, uint8_t *data, uint8_t length );
+    boolean   probe( uint8_t address, uint8_t reg, uint8_t *data, uint8_t length );   // single read attempt, not counted as an error
+    void      recover( void );      // clock a stuck slave free and reset the multiplexer
+    void      setCallbacks( i2cErrorCallback_t onError, i2cRecoveryCallback_t onRecovery );    // either may be 0
+
+    uint16_t  getErrorCount( uint8_t device );      // failed transactions, after all retries
+    uint16_t  getRetryCount( uint8_t device );      // transactions that only succeeded after a retry
+    uint16_t  getRecoveryCount( void );             // changes whenever the multiplexer was reset
+    void      clearErrorCounts( void );
+
+  private:
+    boolean   transfer( uint8_t address, const uint8_t *data, uint8_t length, uint8_t *rxData, uint8_t rxLength );
+    void      reportFailure( uint8_t device, uint8_t address, uint8_t reg );
+    void      reportSuccess( uint8_t device, uint8_t attempt );
+
+    int8_t    _sclPin;
+    int8_t    _sdaPin;
+    int8_t    _muxResetPin;
+    uint8_t   _consecutiveErrors;
+    uint16_t  _errorCount[I2C_MAX_DEVICES];
+    uint16_t  _retryCount[I2C_MAX_DEVICES];
+    uint16_t  _recoveryCount;
+    i2cErrorCallback_t     _onError;
+    i2cRecoveryCallback_t  _onRecovery;
+};
+
+extern I2CBus I2C;
+
+#endif
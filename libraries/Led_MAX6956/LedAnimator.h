@@ -0,0 +1,164 @@
+/* LedAnimator.h
+non-blocking status animations on the MAX6956 LEDs, stepped from loop()
+LED_DRIVER is the board's Led_MAX6956<BOARD>.
+*/
+
+#ifndef _LED_ANIMATOR_H_
+#define _LED_ANIMATOR_H_
+
+#include <Arduino.h>
+#include "Led_MAX6956.h"
+
+#define LED_ANIMATION_IDLE      0xFFFFFFFF      // getIdleTime() when no animation is playing
+#define LED_ANIMATOR_RGB_LEDS   3
+
+// animation priorities, a running animation is only replaced by one of the same or higher priority
+#define LED_ANIMATION_PRIORITY_STATUS    0     // boot, connection state
+#define LED_ANIMATION_PRIORITY_EVENT     1     // user actions, e.g. workout start/stop
+
+typedef struct
+{
+  uint8_t   rgbMask;        // bit n set: RGB LED n is on (RED_LED, GREEN_LED, BLUE_LED)
+  uint8_t   ledMask;        // bit n set: LED n+1 is on
+  uint16_t  duration;       // ms until the next keyframe
+}
+ledKeyframe_t;
+
+typedef struct
+{
+  const ledKeyframe_t  *keyframes;
+  uint8_t   numberOfKeyframes;
+  uint8_t   priority;
+}
+ledAnimation_t;
+
+template <class LED_DRIVER>
+class LedAnimator
+{
+  public:
+    LedAnimator( LED_DRIVER *ledDrv )
+    {
+      _ledDrv = ledDrv;
+      _requested = 0;
+      _cancelRequested = false;
+      _animation = 0;
+      _keyframe = 0;
+      _keyframeStartTime = 0;
+      _rgbState = 0;
+      _ledState = 0;
+    }
+
+    // queue an animation, it replaces the running one unless that has a higher priority.
+    // No I2C here: BLE callbacks may call this while loop() is in the middle of a transaction.
+    boolean play( const ledAnimation_t *animation )
+    {
+      if (animation->numberOfKeyframes == 0)  return false;
+      const ledAnimation_t *running = _requested ? _requested : _animation;
+      if (running && (running->priority > animation->priority))  return false;
+      _requested = animation;
+      return true;
+    }
+
+    // stop the running animation with the next update(), its LEDs are switched off
+    void cancel( void )
+    {
+      _requested = 0;
+      _cancelRequested = true;
+    }
+
+    // call from loop(), switches to the keyframe that is due. Returns true while an animation is playing
+    boolean update( uint32_t now )
+    {
+      // take the requests of play()/cancel() in one step, a BLE callback in between must not be lost
+      noInterrupts();
+      boolean cancelRequested = _cancelRequested;
+      const ledAnimation_t *requested = _requested;
+      _cancelRequested = false;
+      _requested = 0;
+      interrupts();
+
+      if (cancelRequested)  stop();
+      if (requested)  {
+        _animation = requested;
+        _keyframe = 0;
+        _keyframeStartTime = now;
+        if (usesLeds(_animation))  {     // the LEDs of the running LED pattern must not show through
+          _ledDrv->LEDsOff();
+          _ledState = 0;
+        }
+        applyKeyframe(_animation->keyframes[0].rgbMask, _animation->keyframes[0].ledMask);
+      }
+      if (!_animation)  return false;
+
+      // after a long wait skip the keyframes that are over, only the current one is written
+      uint8_t keyframe = _keyframe;
+      while (now - _keyframeStartTime >= _animation->keyframes[_keyframe].duration)  {
+        _keyframeStartTime += _animation->keyframes[_keyframe].duration;
+        _keyframe++;
+        if (_keyframe >= _animation->numberOfKeyframes)  {
+          stop();
+          return false;
+        }
+      }
+      if (_keyframe != keyframe)  {
+        applyKeyframe(_animation->keyframes[_keyframe].rgbMask, _animation->keyframes[_keyframe].ledMask);
+      }
+      return true;
+    }
+
+    boolean isPlaying( void )
+    {
+      return (_animation != 0) || (_requested != 0);
+    }
+
+    // ms until update() has to switch the next keyframe
+    uint32_t getIdleTime( uint32_t now )
+    {
+      if (_requested || _cancelRequested)  return 0;
+      if (!_animation)  return LED_ANIMATION_IDLE;
+      uint32_t elapsed = now - _keyframeStartTime;
+      uint16_t duration = _animation->keyframes[_keyframe].duration;
+      return (elapsed < duration) ? duration - elapsed : 0;
+    }
+
+  private:
+    // switch only the LEDs whose state differs from the previous keyframe, all measurement LEDs in one write
+    void applyKeyframe( uint8_t rgbMask, uint8_t ledMask )
+    {
+      for (uint8_t i = 0; i < LED_ANIMATOR_RGB_LEDS; i++)  {
+        uint8_t bit = 1 << i;
+        if ((rgbMask ^ _rgbState) & bit)  {
+          if (rgbMask & bit)  _ledDrv->RGBLedOn(i);
+          else  _ledDrv->RGBLedOff(i);
+        }
+      }
+      if (ledMask != _ledState)  _ledDrv->setLEDs(ledMask);
+      _rgbState = rgbMask;
+      _ledState = ledMask;
+    }
+
+    boolean usesLeds( const ledAnimation_t *animation )
+    {
+      for (uint8_t i = 0; i < animation->numberOfKeyframes; i++)  {
+        if (animation->keyframes[i].ledMask)  return true;
+      }
+      return false;
+    }
+
+    void stop( void )
+    {
+      applyKeyframe(0, 0);
+      _animation = 0;
+    }
+
+    LED_DRIVER  *_ledDrv;
+    const ledAnimation_t * volatile  _requested;    // set by play(), started by the next update()
+    volatile boolean  _cancelRequested;
+    const ledAnimation_t  *_animation;
+    uint8_t   _keyframe;
+    uint32_t  _keyframeStartTime;
+    uint8_t   _rgbState;        // LEDs switched on by the animation
+    uint8_t   _ledState;
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+Dyno V5.0 rev A
+Written by: Samuel Huberman, Stefan Kalchmair
+Date updated: 6-June-2015
+LED driver MAX6956, shared by all boards
+
+The driver is a template on a board description class, see wearable_device/LedBoard.h for an example:
+  enum constants   NUM_LEDS, FIRST_LED_PORT, PORTS_PER_LED      LED n+1 is on ports FIRST_LED_PORT + n * PORTS_PER_LED ...
+                   RED_LED_PORT, GREEN_LED_PORT, BLUE_LED_PORT
+                   BUTTON1_PORT, BUTTON2_PORT, BATTERY_STAT_PORT     inputs, ports 28-31
+                   NUM_LED_PATTERNS
+  static const ledPattern_t  patterns[NUM_LED_PATTERNS];           applied in index order by toggleLEDs_and_dark()
+  static boolean  write( const uint8_t *data, uint8_t length );    one I2C write to the MAX6956, register address first
+  static boolean  read( uint8_t reg, uint8_t *value );             read one register
+All port and register numbers are compile time constants; the board only costs the RAM of the driver itself.
+*/
+
+#ifndef _LED_MAX6956_H
+#define _LED_MAX6956_H
+
+#include <Arduino.h>
+#include <RegisterCache.h>
+
+#define MAX6956_ADDRESS           0x44
+#define MAX6956_CONFIG_REG        0x04
+#define MAX6956_PORT_CONFIG_REG   0x09   // ports 4-7, auto-increment through 0x0F (ports 28-31)
+
+// register addresses of a port 4-31
+#define MAX6956_PORT_REG(port)          (0x20 + (port))     // single port, bit 0 = state
+#define MAX6956_CURRENT_REG(port)       (0x10 + ((port) >> 1))  // two ports per register, the even port in the low nibble
+#define MAX6956_PORT_BLOCK_REG(port)    (0x40 + (port))     // multi-port, bit n = port + n, up to port 31
+
+#define MAX6956_FIRST_PORT        4
+#define MAX6956_FIRST_INPUT_PORT  28     // ports 28-31 are inputs on all boards
+#define MAX6956_INPUTS_RELEASED   0x0F   // pull-ups: all inputs high
+
+#define MAX6956_CACHED_REGISTERS  0x40   // shadow registers 0x00 - 0x3F (configuration, current and single port registers)
+#define MAX6956_MAX_BURST         17     // registers per auto-increment write, all port registers 12-28
+
+#define RED_LED     0
+#define GREEN_LED   1
+#define BLUE_LED    2
+
+#define LED_ON         true
+#define LED_OFF        false
+
+#define LED_CURRENT_UNCHANGED   0xFF    // ledPattern_t: keep the current set with setBrightness()
+
+// one LED illumination pattern, the pattern number is its index in the board's patterns[]
+typedef struct
+{
+  uint8_t   ledMask;        // bit n set: LED n+1 is on
+  uint8_t   current;        // current level 0-15 of the LEDs that are on, or LED_CURRENT_UNCHANGED
+  uint8_t   settleTime;     // ms the light needs after switching before an integration may start
+}
+ledPattern_t;
+
+template <class BOARD>
+class Led_MAX6956
+{
+  public:
+    enum
+    {
+      NUM_LEDS          = BOARD::NUM_LEDS,
+      NUM_LED_PATTERNS  = BOARD::NUM_LED_PATTERNS,
+    };
+
+    Led_MAX6956();
+
+    boolean  begin   ( void );
+    void toggleLEDs_and_dark( void );
+    void applyLEDpattern( uint8_t pattern );
+    uint8_t getPatternSettleTime( uint8_t pattern );
+    void setLEDs( uint8_t ledMask );      // bit n set: LED n+1 on, all LEDs in one transaction
+    void LEDsOff( void );
+    void ledOff( uint8_t lednum );
+    void ledOn( uint8_t lednum );
+    void setBrightness( uint8_t lednum, uint8_t brightness );
+    void RGBLedOff( uint8_t lednum );
+    void RGBLedOn( uint8_t lednum );
+    void setRGBLedBrightness( uint8_t lednum, uint8_t brightness );
+
+    uint8_t getNumberOfLEDpatterns( void );
+    uint8_t getCurrentLEDpattern( void );
+
+    boolean pollInputs ( void );          // read ports 28-31 in one transaction, returns true if an input changed
+    uint8_t getInputChanges ( void );     // bits of the ports 28-31 that changed with the last pollInputs()
+    boolean hasInputChanged ( uint8_t port );
+    boolean isButton1Pressed ( void );    // state of the last pollInputs()
+    boolean isButton2Pressed ( void );
+    boolean isCharging ( void );
+
+    void invalidateRegisterCache( void );
+
+  private:
+    enum
+    {
+      LED_BLOCK_REG       = MAX6956_PORT_BLOCK_REG(BOARD::FIRST_LED_PORT),  // the LEDs share one multi-port register
+      FIRST_LED_PORT_REG  = MAX6956_PORT_REG(BOARD::FIRST_LED_PORT),
+      LED_PORT_MASK       = (1 << BOARD::PORTS_PER_LED) - 1,                  // ports of LED1 in the block
+      ALL_LED_PORTS       = (1 << (BOARD::NUM_LEDS * BOARD::PORTS_PER_LED)) - 1,
+      INPUT_BLOCK_REG     = MAX6956_PORT_BLOCK_REG(MAX6956_FIRST_INPUT_PORT),
+      FIRST_CURRENT_REG   = MAX6956_CURRENT_REG(BOARD::FIRST_LED_PORT),
+      LED_CURRENT_REGS    = MAX6956_CURRENT_REG(BOARD::FIRST_LED_PORT + BOARD::NUM_LEDS * BOARD::PORTS_PER_LED - 1) - FIRST_CURRENT_REG + 1,
+    };
+
+    // all LED ports have to fit into one multi-port register that does not reach the inputs, the inputs have to be ports 28-31
+    typedef char  ledBlockCheck_t[(BOARD::FIRST_LED_PORT >= MAX6956_FIRST_PORT && BOARD::FIRST_LED_PORT + 8 <= MAX6956_FIRST_INPUT_PORT
+                                   && BOARD::NUM_LEDS * BOARD::PORTS_PER_LED <= 8) ? 1 : -1];
+    typedef char  inputPortCheck_t[(BOARD::BUTTON1_PORT >= MAX6956_FIRST_INPUT_PORT && BOARD::BUTTON2_PORT >= MAX6956_FIRST_INPUT_PORT
+                                    && BOARD::BATTERY_STAT_PORT >= MAX6956_FIRST_INPUT_PORT) ? 1 : -1];
+
+    void     writeRegister( uint8_t reg, uint8_t value );
+    void     writeRegisterBurst( uint8_t reg, const uint8_t *values, uint8_t count );
+    void     writePortBlock( uint8_t multiPortReg, uint8_t firstPortReg, uint8_t mask, uint8_t states );
+    uint8_t  getLedPorts( uint8_t ledMask );
+    uint8_t  getRGBLedPort( uint8_t lednum );
+    uint8_t  getInputBit( uint8_t port );
+
+    boolean  _initialized;
+    uint8_t  ledPattern;
+    uint8_t  _ledStates;        // bit n set: LED n+1 is on
+    uint8_t  _inputs;           // port 28-31 snapshot of the last pollInputs()
+    uint8_t  _inputChanges;
+
+    RegisterCache<MAX6956_CACHED_REGISTERS>  _regCache;
+};
+
+// template member definitions
+#include "Led_MAX6956_impl.h"
+
+#endif
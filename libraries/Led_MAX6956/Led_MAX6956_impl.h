@@ -0,0 +1,328 @@
+/* Led_MAX6956_impl.h
+template member definitions of Led_MAX6956, included by Led_MAX6956.h
+*/
+
+#ifndef _LED_MAX6956_IMPL_H
+#define _LED_MAX6956_IMPL_H
+
+#define LED_MAX6956_TEMPLATE  template <class BOARD>
+#define LED_MAX6956_CLASS     Led_MAX6956<BOARD>
+
+LED_MAX6956_TEMPLATE
+LED_MAX6956_CLASS::Led_MAX6956(void)
+{
+  // can't use wire here, since wire is not initialized yet
+  _initialized = false;
+  ledPattern = 0;
+  _ledStates = 0;
+  _inputs = MAX6956_INPUTS_RELEASED;
+  _inputChanges = 0;
+}
+
+LED_MAX6956_TEMPLATE
+boolean LED_MAX6956_CLASS::begin(void)
+{
+  invalidateRegisterCache();
+
+  // Set configuration register
+  writeRegister(MAX6956_CONFIG_REG, 0x41); // Set the shutdown/run bit of the configuration register (aka normal mode??) 0x is global current mode? 4x individual??
+
+  // Configure ports as LED drive mode (Table 1, Table 2, Table 5)
+  const uint8_t portConfig[] = {
+    MAX6956_PORT_CONFIG_REG, // select ports 4-7
+    0x55, // set ports  4-7  NOT CONNECTED, set as GPIO output to save power and autoinc
+    0x55, // set ports  8-11 NOT CONNECTED, set as GPIO output to save power and autoinc
+    0x00, // set ports 12-15 as LED driver and autoinc
+    0x00, // set ports 16-19 as LED driver and autoinc
+    0x00, // set ports 20-23 as LED driver and autoinc
+    0x00, // set ports 24-27 as LED driver and autoinc
+    0xFF, // set ports 28-31 as GPIO input with pullup
+  };
+  boolean configured = BOARD::write(portConfig, sizeof(portConfig));
+
+  // Turn off all LEDs: ports 12-28 in one auto-increment transaction
+  const uint8_t zeros[MAX6956_MAX_BURST] = {0};
+  writeRegisterBurst(MAX6956_PORT_REG(12), zeros, 17);
+  _ledStates = 0;
+
+  // Set individual current registers for LEDs (Table 11, Table 12): ALL DIM, registers 0x13-0x1F in one transaction
+  writeRegisterBurst(MAX6956_CURRENT_REG(6), zeros, 13);
+
+  _initialized = configured;
+  return _initialized;
+}
+
+LED_MAX6956_TEMPLATE
+uint8_t LED_MAX6956_CLASS::getNumberOfLEDpatterns( void )
+{
+  return NUM_LED_PATTERNS;
+}
+
+LED_MAX6956_TEMPLATE
+uint8_t LED_MAX6956_CLASS::getCurrentLEDpattern( void )
+{
+  return ledPattern;
+}
+
+// switch to the next LED pattern of the board's pattern table
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::toggleLEDs_and_dark( void )
+{
+  uint8_t pattern = ledPattern + 1;
+  if (pattern >= NUM_LED_PATTERNS)  {
+    pattern = 0;
+  }
+  applyLEDpattern(pattern);
+}
+
+// set the current of the pattern's LEDs (one burst, only if a level changes), then switch all LEDs in one write
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::applyLEDpattern( uint8_t pattern )
+{
+  if (pattern >= NUM_LED_PATTERNS)  return;
+  const ledPattern_t *p = &BOARD::patterns[pattern];
+  if (p->current != LED_CURRENT_UNCHANGED)  {
+    uint8_t current[LED_CURRENT_REGS];
+    for (uint8_t i = 0; i < LED_CURRENT_REGS; i++)  {
+      current[i] = _regCache.isValid(FIRST_CURRENT_REG + i) ? _regCache.get(FIRST_CURRENT_REG + i) : 0x00;
+    }
+    uint8_t ports = getLedPorts(p->ledMask);
+    for (uint8_t i = 0; i < NUM_LEDS * BOARD::PORTS_PER_LED; i++)  {
+      if (!(ports & (1 << i)))  continue;
+      uint8_t port = BOARD::FIRST_LED_PORT + i;
+      uint8_t *reg = &current[MAX6956_CURRENT_REG(port) - FIRST_CURRENT_REG];
+      if (port & 0x01)  *reg = (*reg & 0x0F) | (p->current << 4);
+      else  *reg = (*reg & 0xF0) | (p->current & 0x0F);
+    }
+    writeRegisterBurst(FIRST_CURRENT_REG, current, LED_CURRENT_REGS);
+  }
+  setLEDs(p->ledMask);
+  ledPattern = pattern;
+}
+
+LED_MAX6956_TEMPLATE
+uint8_t LED_MAX6956_CLASS::getPatternSettleTime( uint8_t pattern )
+{
+  if (pattern >= NUM_LED_PATTERNS)  return 0;
+  return BOARD::patterns[pattern].settleTime;
+}
+
+// switch all LEDs with one write to the multi-port register, the other ports of the block keep their state
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::setLEDs( uint8_t ledMask )
+{
+  writePortBlock(LED_BLOCK_REG, FIRST_LED_PORT_REG, ALL_LED_PORTS, getLedPorts(ledMask));
+  _ledStates = ledMask;
+}
+
+// function to turn LEDs off
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::LEDsOff( void )
+{
+  setLEDs(0x00);
+}
+
+// turn LED off
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::ledOff( uint8_t lednum )
+{
+  setLEDs(_ledStates & ~(1 << lednum));
+}
+
+// turn LED on
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::ledOn( uint8_t lednum )
+{
+  setLEDs(_ledStates | (1 << lednum));
+}
+
+// port bits within the LED block of the LEDs in ledMask
+LED_MAX6956_TEMPLATE
+uint8_t LED_MAX6956_CLASS::getLedPorts( uint8_t ledMask )
+{
+  if (BOARD::PORTS_PER_LED == 1)  return ledMask;
+  uint8_t ports = 0;
+  for (uint8_t i = 0; i < NUM_LEDS; i++)  {
+    if (ledMask & (1 << i))  ports |= LED_PORT_MASK << (i * BOARD::PORTS_PER_LED);
+  }
+  return ports;
+}
+
+// set LED brightness: current register of the LED's (first) port, both nibbles
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::setBrightness( uint8_t lednum, uint8_t brightness )
+{
+  writeRegister(MAX6956_CURRENT_REG(BOARD::FIRST_LED_PORT + lednum * BOARD::PORTS_PER_LED), brightness);
+}
+
+/* --- RGB LED --- */
+
+LED_MAX6956_TEMPLATE
+uint8_t LED_MAX6956_CLASS::getRGBLedPort( uint8_t lednum )
+{
+  if (lednum == RED_LED)  return BOARD::RED_LED_PORT;
+  if (lednum == GREEN_LED)  return BOARD::GREEN_LED_PORT;
+  return BOARD::BLUE_LED_PORT;
+}
+
+// turn RGB LED off
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::RGBLedOff( uint8_t lednum )
+{
+  writeRegister(MAX6956_PORT_REG(getRGBLedPort(lednum)), 0x00);
+}
+
+// turn RGB LED on
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::RGBLedOn( uint8_t lednum )
+{
+  writeRegister(MAX6956_PORT_REG(getRGBLedPort(lednum)), 0x01);
+}
+
+// set LED brightness
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::setRGBLedBrightness( uint8_t lednum, uint8_t brightness )
+{
+  writeRegister(MAX6956_CURRENT_REG(getRGBLedPort(lednum)), brightness);
+}
+
+/* --- register access --- */
+
+// forget all cached register values, call after the driver was reset or power cycled
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::invalidateRegisterCache( void )
+{
+  _regCache.invalidateAll();
+}
+
+// write one register, skip the write if the register holds the value already
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::writeRegister( uint8_t reg, uint8_t value )
+{
+  if (_regCache.isCached(reg, value))  return;
+  uint8_t data[2] = {reg, value};
+  if (!BOARD::write(data, 2))  {
+    _regCache.invalidate(reg);
+    return;
+  }
+  _regCache.store(reg, value);
+}
+
+// write count consecutive registers in one transaction (auto-increment), skip the write if all hold the values already
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::writeRegisterBurst( uint8_t reg, const uint8_t *values, uint8_t count )
+{
+  if (count > MAX6956_MAX_BURST)  return;
+  boolean cached = true;
+  uint8_t data[MAX6956_MAX_BURST + 1];
+  data[0] = reg;
+  for (uint8_t i = 0; i < count; i++)  {
+    data[i + 1] = values[i];
+    if (!_regCache.isCached(reg + i, values[i]))  cached = false;
+  }
+  if (cached)  return;
+
+  boolean written = BOARD::write(data, count + 1);
+  for (uint8_t i = 0; i < count; i++)  {
+    if (written)  _regCache.store(reg + i, values[i]);
+    else  _regCache.invalidate(reg + i);
+  }
+}
+
+// set the ports in mask of an 8 port block (bit n = port firstPortReg + n) through its multi-port register,
+// the other ports of the block are rewritten with their cached state. If one of those is not known,
+// the masked ports are written one by one instead.
+LED_MAX6956_TEMPLATE
+void LED_MAX6956_CLASS::writePortBlock( uint8_t multiPortReg, uint8_t firstPortReg, uint8_t mask, uint8_t states )
+{
+  uint8_t blockValue = 0;
+  boolean changed = false;
+  boolean known = true;
+  for (uint8_t i = 0; i < 8; i++)  {
+    uint8_t reg = firstPortReg + i;
+    uint8_t bit = 1 << i;
+    if (mask & bit)  {
+      uint8_t portValue = (states & bit) ? 0x01 : 0x00;
+      if (!_regCache.isCached(reg, portValue))  changed = true;
+      if (portValue)  blockValue |= bit;
+    }
+    else if (_regCache.isValid(reg))  {
+      if (_regCache.get(reg) & 0x01)  blockValue |= bit;
+    }
+    else  known = false;
+  }
+  if (!changed)  return;
+
+  if (!known)  {
+    for (uint8_t i = 0; i < 8; i++)  {
+      if (mask & (1 << i))  writeRegister(firstPortReg + i, (states >> i) & 0x01);
+    }
+    return;
+  }
+
+  uint8_t data[2] = {multiPortReg, blockValue};
+  boolean written = BOARD::write(data, 2);
+  for (uint8_t i = 0; i < 8; i++)  {     // the multi-port write changes the single port registers
+    if (written)  _regCache.store(firstPortReg + i, (blockValue >> i) & 0x01);
+    else  _regCache.invalidate(firstPortReg + i);
+  }
+}
+
+/* --- read from ports (Buttons, charge status pin) --- */
+
+// Read all inputs with one read of the multi-port register instead of one transaction per input.
+// The transition detection of the MAX6956 can't replace the polling: it needs port 31 as interrupt output,
+// and port 31 is an input on all boards. If the read fails, the last snapshot is kept and no change is reported.
+LED_MAX6956_TEMPLATE
+boolean LED_MAX6956_CLASS::pollInputs ( void )
+{
+  uint8_t inputs;
+  _inputChanges = 0;
+  if (!BOARD::read(INPUT_BLOCK_REG, &inputs))  return false;
+  inputs &= MAX6956_INPUTS_RELEASED;
+  _inputChanges = inputs ^ _inputs;
+  _inputs = inputs;
+  return _inputChanges != 0;
+}
+
+LED_MAX6956_TEMPLATE
+uint8_t LED_MAX6956_CLASS::getInputChanges ( void )
+{
+  return _inputChanges;
+}
+
+LED_MAX6956_TEMPLATE
+boolean LED_MAX6956_CLASS::hasInputChanged ( uint8_t port )
+{
+  return (_inputChanges & getInputBit(port)) != 0;
+}
+
+LED_MAX6956_TEMPLATE
+boolean LED_MAX6956_CLASS::isButton1Pressed ( void )
+{
+  return (_inputs & getInputBit(BOARD::BUTTON1_PORT)) == 0;      // Pulldown: 0=pressed, 1=not pressed
+}
+
+LED_MAX6956_TEMPLATE
+boolean LED_MAX6956_CLASS::isButton2Pressed ( void )
+{
+  return (_inputs & getInputBit(BOARD::BUTTON2_PORT)) == 0;      // Pulldown: 0=pressed, 1=not pressed
+}
+
+LED_MAX6956_TEMPLATE
+boolean LED_MAX6956_CLASS::isCharging ( void )
+{
+  return (_inputs & getInputBit(BOARD::BATTERY_STAT_PORT)) == 0;      // Pulldown: 0=pressed, 1=not pressed
+}
+
+// bit of an input port 28-31 in the snapshot
+LED_MAX6956_TEMPLATE
+uint8_t LED_MAX6956_CLASS::getInputBit( uint8_t port )
+{
+  return 1 << (port - MAX6956_FIRST_INPUT_PORT);
+}
+
+#undef LED_MAX6956_TEMPLATE
+#undef LED_MAX6956_CLASS
+
+#endif
@@ -0,0 +1,64 @@
+/* RegisterCache.h
+write-through shadow copy of I2C device registers
+used by the sensor, LED driver and fuel gauge drivers to skip writes that would not change a register
+*/
+
+#ifndef _REGISTER_CACHE_H_
+#define _REGISTER_CACHE_H_
+
+#include <Arduino.h>
+
+// SIZE cached 8 bit registers, addressed by a driver specific index 0 .. SIZE-1
+// All entries start out invalid; invalidate entries whenever the device may have changed them on its own (reset, power cycle, failed write)
+template <uint8_t SIZE>
+class RegisterCache
+{
+  public:
+    RegisterCache()
+    {
+      invalidateAll();
+    }
+
+    // true if the register is known to hold this value already, i.e. the write can be skipped
+    boolean isCached( uint8_t index, uint8_t value )
+    {
+      return isValid(index) && (_value[index] == value);
+    }
+
+    // true if the register content is known
+    boolean isValid( uint8_t index )
+    {
+      return (_valid[index >> 3] & (1 << (index & 0x07))) != 0;
+    }
+
+    // cached register content, only meaningful if isValid()
+    uint8_t get( uint8_t index )
+    {
+      return _value[index];
+    }
+
+    // remember a value that was successfully written to or read from the device
+    void store( uint8_t index, uint8_t value )
+    {
+      _value[index] = value;
+      _valid[index >> 3] |= 1 << (index & 0x07);
+    }
+
+    void invalidate( uint8_t index )
+    {
+      _valid[index >> 3] &= ~(1 << (index & 0x07));
+    }
+
+    void invalidateAll( void )
+    {
+      for (uint8_t i = 0; i < sizeof(_valid); i++)  {
+        _valid[i] = 0;
+      }
+    }
+
+  private:
+    uint8_t  _value[SIZE];
+    uint8_t  _valid[(SIZE + 7) / 8];
+};
+
+#endif
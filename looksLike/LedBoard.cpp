@@ -0,0 +1,14 @@
+/* LedBoard.cpp
+LED patterns of the looksLike PCB
+*/
+
+#include "LedBoard.h"
+
+// LED patterns in the order toggleLEDs_and_dark() applies them, a new pattern is just another line here.
+// LED1 .. LED8 are ports 12-19, so the LED mask is the image of the multi-port register.
+const ledPattern_t LooksLikeLedBoard::patterns[NUM_LED_PATTERNS] = {
+  // LEDs on,                                  current, settle time
+  { 0,                                          0x0,     0 },     // 0: dark, ambient light only
+  { (1 << LED4) | (1 << LED5) | (1 << LED6),    0xF,     0 },     // 1: 855 nm LED4, 680 nm LED5 + LED6
+  { (1 << LED1) | (1 << LED2) | (1 << LED3),    0x5,     0 },     // 2: 855 nm LED1 - LED3
+};
@@ -0,0 +1,76 @@
+/* LedBoard.h
+LEDs, RGB status LED and inputs of the looksLike PCB on the MAX6956 LED driver
+*/
+
+#ifndef _LED_BOARD_H_
+#define _LED_BOARD_H_
+
+#include <I2CBus.h>
+#include <Led_MAX6956.h>
+#include <LedAnimator.h>
+
+#define NUMBER_OF_LEDS 8
+#define NUMBER_OF_LED_PATTERNS            3       // Number of LED illumination patterns: e.g. all 680 nm LEDs, one 810 nm LED and dark measurement
+
+#define LED1_NAME  "855nm"
+#define LED2_NAME  "855nm"
+#define LED3_NAME  "855nm"
+#define LED4_NAME  "855nm"
+#define LED5_NAME  "680nm"
+#define LED6_NAME  "680nm"
+#define LED7_NAME  "680nm"
+#define LED8_NAME  "680nm"
+
+typedef enum {
+  LED1  = 0,
+  LED2  = 1,
+  LED3  = 2,
+  LED4  = 3,
+  LED5  = 4,
+  LED6  = 5,
+  LED7  = 6,
+  LED8  = 7,
+  LAST_LED = LED8,
+} Portnum_t;
+
+// devices on the I2C bus of the looksLike PCB, each one has its own error counter in I2CBus
+typedef enum
+{
+  I2C_DEVICE_LED_DRIVER       = 0,    // MAX6956
+  I2C_NUMBER_OF_DEVICES       = 1,
+}
+i2cDevice_t;
+
+class LooksLikeLedBoard
+{
+  public:
+    enum
+    {
+      NUM_LEDS            = NUMBER_OF_LEDS,
+      NUM_LED_PATTERNS    = NUMBER_OF_LED_PATTERNS,
+      FIRST_LED_PORT      = 12,     // LED1 .. LED8 = ports 12 .. 19
+      PORTS_PER_LED       = 1,
+      RED_LED_PORT        = 24,
+      GREEN_LED_PORT      = 22,
+      BLUE_LED_PORT       = 23,
+      BUTTON1_PORT        = 29,
+      BUTTON2_PORT        = 30,
+      BATTERY_STAT_PORT   = 31,
+    };
+
+    static const ledPattern_t  patterns[NUM_LED_PATTERNS];     // LedBoard.cpp
+
+    static boolean write( const uint8_t *data, uint8_t length )
+    {
+      return I2C.write(I2C_DEVICE_LED_DRIVER, MAX6956_ADDRESS, data, length);
+    }
+
+    static boolean read( uint8_t reg, uint8_t *value )
+    {
+      return I2C.read(I2C_DEVICE_LED_DRIVER, MAX6956_ADDRESS, reg, value, 1);
+    }
+};
+
+typedef Led_MAX6956<LooksLikeLedBoard>  LedDriver;
+
+#endif
@@ -4,14 +4,34 @@ Dyno V7.0 looks like
 
 #include <RFduinoBLE.h>
 #include <Wire.h>
-#include "Led_Max6956.h"
+#include <I2CBus.h>
+#include "LedBoard.h"
 
 #define PIN_WIRE_SDA         5
 #define PIN_WIRE_SCL         6
 #define POWER_BUTTON         4
 #define START_BUTTON         3
 
-Led_MAX6956 LedDrv;
+LedDriver LedDrv;
+LedAnimator<LedDriver> Anim(&LedDrv);
+
+// LED animations, played from loop() without stopping it
+const ledKeyframe_t ChaseKeyframes[] = {
+  { 0, 1 << LED1, 100 },
+  { 0, 1 << LED2, 100 },
+  { 0, 1 << LED3, 100 },
+  { 0, 1 << LED2, 100 },
+  { 0, 1 << LED1, 100 },
+};
+const ledKeyframe_t StopKeyframes[] = {
+  { 0, 1 << LED3, 100 },
+  { 0, 1 << LED2, 100 },
+  { 0, 1 << LED1, 100 },
+};
+const ledAnimation_t StartupAnimation = { ChaseKeyframes, sizeof(ChaseKeyframes) / sizeof(ChaseKeyframes[0]), LED_ANIMATION_PRIORITY_STATUS };
+const ledAnimation_t ConnectAnimation = { ChaseKeyframes, sizeof(ChaseKeyframes) / sizeof(ChaseKeyframes[0]), LED_ANIMATION_PRIORITY_STATUS };
+const ledAnimation_t WorkoutStartAnimation = { ChaseKeyframes, sizeof(ChaseKeyframes) / sizeof(ChaseKeyframes[0]), LED_ANIMATION_PRIORITY_EVENT };
+const ledAnimation_t WorkoutStopAnimation = { StopKeyframes, sizeof(StopKeyframes) / sizeof(StopKeyframes[0]), LED_ANIMATION_PRIORITY_EVENT };
 
 // debounce time (in ms)
 int debounce_time = 10;
@@ -67,11 +87,11 @@ typedef struct {
   byte infoByte;									// 1 byte
   byte SDCardStatus;              // 1 byte
   int time; 											// 4 bytes
-  float cellVoltage; 							// 4 bytes
-  float stateOfCharge; 						// 4 bytes
+  unsigned short cellVoltage;     // 2 bytes, mV
+  unsigned short stateOfCharge;   // 2 bytes, 1/256 %
   unsigned short temp_skin;      	// 2 bytes
   unsigned short temp_amb;       	// 2 bytes
-  // 3 bytes left
+  // 4 bytes left
 } info_packet;
 
 
@@ -80,7 +100,7 @@ void setup()
 {
   boolean stat;
   // Start I2C, serial, and BLE stack
-  Wire.beginOnPins(PIN_WIRE_SCL, PIN_WIRE_SDA);
+  I2C.begin(PIN_WIRE_SCL, PIN_WIRE_SDA, I2C_NO_PIN);
 
   // Cannot write to Serial while writing to the SD card, might corrupt the SD card otherwise
   Serial.begin(9600);
@@ -121,22 +141,7 @@ void setup()
   //Batt.quickStart();
 
   // Startup animation
-  LedDrv.ledOn(LED1);
-  delay(100);
-  LedDrv.ledOff(LED1);
-  LedDrv.ledOn(LED2);
-  delay(100);
-  LedDrv.ledOff(LED2);
-  LedDrv.ledOn(LED3);
-  delay(100);
-  LedDrv.ledOff(LED3);
-  LedDrv.ledOn(LED2);
-  delay(100);
-  LedDrv.ledOff(LED2);
-  LedDrv.ledOn(LED1);
-  delay(100);
-  LedDrv.ledOff(LED1);
-
+  Anim.play(&StartupAnimation);
 }
 
 
@@ -148,24 +153,31 @@ void loop()
   info_packet infoStruct;
   ir_packet irStruct;
 
-  if (LedDrv.isButton1Pressed())
-    LedDrv.RGBLedOn(GREEN_LED);
-  else
-    LedDrv.RGBLedOff(GREEN_LED);
+  // one read of the buttons and the charge status pin, the status LED only changes when button 1 does
+  LedDrv.pollInputs();
+  if (LedDrv.hasInputChanged(LooksLikeLedBoard::BUTTON1_PORT)) {
+    if (LedDrv.isButton1Pressed())
+      LedDrv.RGBLedOn(GREEN_LED);
+    else
+      LedDrv.RGBLedOff(GREEN_LED);
+  }
 
 
-  // toggle 660nm and  855 nm LEDs
-  LedDrv.toggleLEDs_and_dark();
+  // toggle 660nm and  855 nm LEDs, unless an animation uses them
+  if (!Anim.update(millis()))
+    LedDrv.toggleLEDs_and_dark();
 
   if (startButtonState == 1)
-    delay(100);   // during workout
+    delayAnimated(100);   // during workout
   else
-    delay(200);   // before/after workout
+    delayAnimated(200);   // before/after workout
 
   if (digitalRead(POWER_BUTTON) == 0)
   {
     Serial.println("Powerbutton pressed!");
     Serial.println("Going to sleep ... zzzz");
+    Anim.cancel();
+    Anim.update(millis());
     LedDrv.LEDsOff();
     delay_until_button(LOW);
     delay(500);
@@ -178,40 +190,16 @@ void loop()
       startButtonState = 1;   // workout running
       Serial.println("Startbutton pressed!");
       // Startup animation
-      LedDrv.LEDsOff();
-      LedDrv.ledOn(LED1);
-      delay(100);
-      LedDrv.ledOff(LED1);
-      LedDrv.ledOn(LED2);
-      delay(100);
-      LedDrv.ledOff(LED2);
-      LedDrv.ledOn(LED3);
-      delay(100);
-      LedDrv.ledOff(LED3);
-      LedDrv.ledOn(LED2);
-      delay(100);
-      LedDrv.ledOff(LED2);
-      LedDrv.ledOn(LED1);
-      delay(100);
-      LedDrv.ledOff(LED1);
+      Anim.play(&WorkoutStartAnimation);
     }
     else if (startButtonState == 1)
     {
       startButtonState = 0;   // workout stopped
       Serial.println("Startbutton pressed!");
       // Stop workout animation
-      LedDrv.LEDsOff();
-      LedDrv.ledOn(LED3);
-      delay(100);
-      LedDrv.ledOff(LED3);
-      LedDrv.ledOn(LED2);
-      delay(100);
-      LedDrv.ledOff(LED2);
-      LedDrv.ledOn(LED1);
-      delay(100);
-      LedDrv.ledOff(LED1);
+      Anim.play(&WorkoutStopAnimation);
     }
-    delay(200);
+    delayAnimated(200);
   }
 
   unsigned short det1FS =  random(65000);
@@ -241,8 +229,8 @@ void loop()
 
   infoStruct.infoByte = 0;
   infoStruct.time = millis();
-  infoStruct.cellVoltage = 3.7;
-  infoStruct.stateOfCharge = 0.96;
+  infoStruct.cellVoltage = 3700;
+  infoStruct.stateOfCharge = 96 << 8;
   infoStruct.temp_skin = 20;
   infoStruct.temp_amb = RFduino_temperature(CELSIUS);
 
@@ -260,28 +248,28 @@ void loop()
 
 void RFduinoBLE_onConnect() {
   Serial.println("BLE connected");
-  // Startup animation
-  LedDrv.ledOn(LED1);
-  delay(100);
-  LedDrv.ledOff(LED1);
-  LedDrv.ledOn(LED2);
-  delay(100);
-  LedDrv.ledOff(LED2);
-  LedDrv.ledOn(LED3);
-  delay(100);
-  LedDrv.ledOff(LED3);
-  LedDrv.ledOn(LED2);
-  delay(100);
-  LedDrv.ledOff(LED2);
-  LedDrv.ledOn(LED1);
-  delay(100);
-  LedDrv.ledOff(LED1);
+  // played by loop(), the BLE stack must not wait for it
+  Anim.play(&ConnectAnimation);
 }
 
 void RFduinoBLE_onDisconnect() {
   Serial.println("BLE disconnected");
 }
 
+// wait ms, the LED animation keeps running meanwhile
+void delayAnimated(uint32_t ms)
+{
+  uint32_t start = millis();
+  uint32_t elapsed;
+  while ((elapsed = millis() - start) < ms)
+  {
+    Anim.update(millis());
+    uint32_t wait = ms - elapsed;
+    uint32_t animationIdleTime = Anim.getIdleTime(millis());
+    delay(wait < animationIdleTime ? wait : animationIdleTime);
+  }
+}
+
 int debounce(int state)
 {
   int start = millis();
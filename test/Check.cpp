@@ -0,0 +1,12 @@
+/* Check.cpp
+*/
+
+#include "Check.h"
+
+int checkFailures = 0;
+
+int checkResult( void )
+{
+  if (checkFailures > 0)  fprintf(stderr, "%d check(s) failed\n", checkFailures);
+  return (checkFailures > 0) ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+/* Check.h
+minimal test assertions for the host tests, every test program returns the number of failed checks
+*/
+
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <stdio.h>
+
+extern int checkFailures;
+
+#define CHECK(condition)  \
+  do {  \
+    if (!(condition))  {  \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition);  \
+      checkFailures++;  \
+    }  \
+  } while (0)
+
+#define CHECK_EQUAL(expected, actual)  \
+  do {  \
+    long long _e = (long long) (expected), _a = (long long) (actual);  \
+    if (_e != _a)  {  \
+      fprintf(stderr, "%s:%d: CHECK_EQUAL failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #expected, #actual, _e, _a);  \
+      checkFailures++;  \
+    }  \
+  } while (0)
+
+// a test program: int main() { ...checks...; return checkResult(); }
+int checkResult( void );
+
+#endif
@@ -0,0 +1,476 @@
+/* Simulator.cpp
+bench simulator for the host tests, implements the Arduino/RFduino stubs in test/stubs
+*/
+
+#include "Simulator.h"
+#include <Wire.h>
+#include <RFduinoBLE.h>
+#include <stdarg.h>
+#include <map>
+
+#define MUX_ADDRESS           0x70
+#define TSL2591_ADDRESS       0x29
+#define MAX6956_ADDRESS       0x44
+#define MAX17043_ADDRESS      0x36
+
+#define TSL2591_REG_ENABLE    0x00
+#define TSL2591_REG_CONTROL   0x01
+#define TSL2591_REG_ID        0x12
+#define TSL2591_REG_STATUS    0x13
+#define TSL2591_REG_C0DATAL   0x14
+#define TSL2591_REG_MASK      0x1F    // register address bits of the command byte
+#define TSL2591_ENABLE_ADC    0x03    // PON | AEN
+
+#define MAX6956_REGISTERS     0x60
+#define MAX6956_PORT          0x20    // single port registers 0x20 + port
+#define MAX6956_MULTI_PORT    0x40    // 8 ports starting at port (register - 0x40)
+#define MAX6956_PORTS         32
+
+HardwareSerial    Serial;
+TwoWire           Wire;
+RFduinoBLEClass   RFduinoBLE;
+SDClass           SD;
+
+static uint32_t   _now;
+static uint32_t   _busTimeUs;       // bus time not yet added to _now
+static uint32_t   _sleepTime;
+static uint32_t   _i2cTransactions;
+static uint32_t   _wakeInterval;
+static uint32_t   _pinWakeEnabled;      // bit n: RFduino_pinWake() enabled pin n
+static uint32_t   _pinWoke;             // bit n: pin n woke the core, latched until RFduino_resetPinWake()
+static int        _twiScl;              // pins of the enabled I2C peripheral, -1 while it is disabled
+static int        _twiSda;
+static uint32_t   _twiPinConflicts;     // pinMode()/digitalWrite() on a pin the I2C peripheral owns
+static bool       _serialEcho;
+static uint8_t    _failAddress;
+static int        _failCount;
+
+static std::vector<std::string>             _blePackets;
+static std::map<std::string, SimFileData>   _files;
+
+// ---- TSL2591 ----
+
+class SimTsl2591
+{
+  public:
+    bool      present;
+    double    light;
+    uint8_t   reg[TSL2591_REG_MASK + 1];
+    uint8_t   pointer;
+    bool      integrating;
+    uint32_t  enableTime;
+
+    void  reset( void );
+    void  write( const uint8_t *data, size_t length );
+    void  read( std::vector<uint8_t> &rx, uint8_t length );
+
+  private:
+    uint32_t  integrationTime( void )  { return ((reg[TSL2591_REG_CONTROL] & 0x07) + 1) * 100; }
+    bool      isValid( void )  { return integrating && (_now - enableTime >= integrationTime() + SIM_TSL2591_AVALID_DELAY); }
+    void      latch( void );
+};
+
+static SimTsl2591   _tsl[SIM_NUMBER_OF_SENSORS];
+static uint8_t      _muxSelect;
+static uint8_t      _maxReg[MAX6956_REGISTERS];
+static uint8_t      _maxPointer;
+static double       _ledLight[MAX6956_PORTS];
+static uint8_t      _fgReg[256];
+static uint8_t      _fgPointer;
+
+void SimTsl2591::reset( void )
+{
+  memset(reg, 0, sizeof(reg));
+  reg[TSL2591_REG_ID] = 0x50;
+  pointer = 0;
+  integrating = false;
+  enableTime = 0;
+}
+
+// ADC result of the finished integration: full spectrum on channel 0, a third of it on the IR channel 1
+void SimTsl2591::latch( void )
+{
+  static const uint32_t gain[4] = { 1, 25, 428, 9876 };
+  double level = light;
+  for (uint8_t port = 0; port < MAX6956_PORTS; port++)  {
+    if (_maxReg[MAX6956_PORT + port] & 0x01)  level += _ledLight[port];
+  }
+  double counts = level * gain[(reg[TSL2591_REG_CONTROL] >> 4) & 0x03] * integrationTime();
+  uint32_t saturation = ((reg[TSL2591_REG_CONTROL] & 0x07) == 0) ? 37888 : 65535;
+  uint32_t full = (counts > saturation) ? saturation : (uint32_t) counts;
+  uint32_t ir = full / 3;
+  reg[TSL2591_REG_C0DATAL] = full & 0xFF;
+  reg[TSL2591_REG_C0DATAL + 1] = full >> 8;
+  reg[TSL2591_REG_C0DATAL + 2] = ir & 0xFF;
+  reg[TSL2591_REG_C0DATAL + 3] = ir >> 8;
+  reg[TSL2591_REG_STATUS] |= 0x01;
+}
+
+void SimTsl2591::write( const uint8_t *data, size_t length )
+{
+  if (length == 0)  return;
+  pointer = data[0] & TSL2591_REG_MASK;
+  if (length < 2)  return;
+  reg[pointer] = data[1];
+  if (pointer != TSL2591_REG_ENABLE)  return;
+
+  bool enable = (data[1] & TSL2591_ENABLE_ADC) == TSL2591_ENABLE_ADC;
+  if (enable && !integrating)  {
+    integrating = true;
+    enableTime = _now;
+    reg[TSL2591_REG_STATUS] = 0;
+  }
+  if (!enable && integrating)  {
+    if (isValid() && !(reg[TSL2591_REG_STATUS] & 0x01))  latch();
+    integrating = false;
+  }
+}
+
+void SimTsl2591::read( std::vector<uint8_t> &rx, uint8_t length )
+{
+  if (isValid() && !(reg[TSL2591_REG_STATUS] & 0x01))  latch();
+  for (uint8_t i = 0; i < length; i++)  {
+    rx.push_back(reg[(pointer + i) & TSL2591_REG_MASK]);
+  }
+}
+
+static SimTsl2591 *selectedTsl( void )
+{
+  for (uint8_t i = 0; i < SIM_NUMBER_OF_SENSORS; i++)  {
+    if (_muxSelect & (1 << i))  return _tsl[i].present ? &_tsl[i] : 0;
+  }
+  return 0;
+}
+
+// ---- MAX6956 ----
+
+static void writeMax6956( const uint8_t *data, size_t length )
+{
+  if (length == 0)  return;
+  _maxPointer = data[0];
+  for (size_t i = 1; i < length; i++, _maxPointer++)  {
+    if (_maxPointer >= MAX6956_REGISTERS)  continue;
+    if (_maxPointer >= MAX6956_MULTI_PORT)  {
+      uint8_t port = _maxPointer - MAX6956_MULTI_PORT;
+      for (uint8_t bit = 0; (bit < 8) && (port + bit < MAX6956_PORTS); bit++)  {
+        _maxReg[MAX6956_PORT + port + bit] = (data[i] >> bit) & 0x01;
+      }
+    }
+    else  {
+      _maxReg[_maxPointer] = data[i];
+    }
+  }
+}
+
+static void readMax6956( std::vector<uint8_t> &rx, uint8_t length )
+{
+  for (uint8_t i = 0; i < length; i++)  {
+    uint8_t r = _maxPointer + i;
+    uint8_t value = 0;
+    if (r >= MAX6956_REGISTERS)  value = 0;
+    else if (r >= MAX6956_MULTI_PORT)  {
+      uint8_t port = r - MAX6956_MULTI_PORT;
+      for (uint8_t bit = 0; (bit < 8) && (port + bit < MAX6956_PORTS); bit++)  {
+        value |= (_maxReg[MAX6956_PORT + port + bit] & 0x01) << bit;
+      }
+    }
+    else  value = _maxReg[r];
+    rx.push_back(value);
+  }
+}
+
+// ---- I2C ----
+
+static uint8_t                _txAddress;
+static std::vector<uint8_t>   _txData;
+static std::vector<uint8_t>   _rxData;
+static size_t                 _rxPosition;
+
+// every transaction takes bus time, so a busy firmware sees the clock move
+static void busTime( size_t bytes )
+{
+  _i2cTransactions++;
+  _busTimeUs += bytes * SIM_BUS_TIME_PER_BYTE + SIM_BUS_TIME_PER_START;
+  _now += _busTimeUs / 1000;
+  _busTimeUs %= 1000;
+}
+
+static bool injectFailure( uint8_t address )
+{
+  if ((_failCount > 0) && ((_failAddress == SIM_ADDR_ANY) || (_failAddress == address)))  {
+    _failCount--;
+    return true;
+  }
+  return false;
+}
+
+void TwoWire::begin( void )  {}
+void TwoWire::beginOnPins( int sclPin, int sdaPin )
+{
+  _twiScl = sclPin;
+  _twiSda = sdaPin;
+}
+void TwoWire::end( void )  { _twiScl = _twiSda = -1; }
+
+void TwoWire::beginTransmission( uint8_t address )
+{
+  _txAddress = address;
+  _txData.clear();
+}
+
+size_t TwoWire::write( uint8_t data )
+{
+  _txData.push_back(data);
+  return 1;
+}
+
+size_t TwoWire::write( const uint8_t *data, size_t length )
+{
+  _txData.insert(_txData.end(), data, data + length);
+  return length;
+}
+
+uint8_t TwoWire::endTransmission( uint8_t sendStop )
+{
+  (void) sendStop;
+  return endTransmission();
+}
+
+// 0 on success, 2 for an address NACK
+uint8_t TwoWire::endTransmission( void )
+{
+  busTime(_txData.size() + 1);
+  if (injectFailure(_txAddress))  return 2;
+
+  const uint8_t *data = _txData.empty() ? 0 : &_txData[0];
+  switch (_txAddress)
+  {
+    case MUX_ADDRESS :
+      if (!_txData.empty())  _muxSelect = _txData[0];
+      return 0;
+    case TSL2591_ADDRESS :
+      if (!selectedTsl())  return 2;
+      selectedTsl()->write(data, _txData.size());
+      return 0;
+    case MAX6956_ADDRESS :
+      writeMax6956(data, _txData.size());
+      return 0;
+    case MAX17043_ADDRESS :
+      if (_txData.empty())  return 0;
+      _fgPointer = _txData[0];
+      for (size_t i = 1; i < _txData.size(); i++)  _fgReg[(uint8_t) (_fgPointer + i - 1)] = _txData[i];
+      return 0;
+    default:
+      return 2;
+  }
+}
+
+// number of bytes received, 0 for an address NACK
+uint8_t TwoWire::requestFrom( uint8_t address, uint8_t length )
+{
+  busTime(length + 1);
+  _rxData.clear();
+  _rxPosition = 0;
+  if (injectFailure(address))  return 0;
+
+  switch (address)
+  {
+    case MUX_ADDRESS :
+      _rxData.assign(length, _muxSelect);
+      break;
+    case TSL2591_ADDRESS :
+      if (!selectedTsl())  return 0;
+      selectedTsl()->read(_rxData, length);
+      break;
+    case MAX6956_ADDRESS :
+      readMax6956(_rxData, length);
+      break;
+    case MAX17043_ADDRESS :
+      for (uint8_t i = 0; i < length; i++)  _rxData.push_back(_fgReg[(uint8_t) (_fgPointer + i)]);
+      break;
+    default:
+      return 0;
+  }
+  return length;
+}
+
+int TwoWire::available( void )
+{
+  return _rxData.size() - _rxPosition;
+}
+
+int TwoWire::read( void )
+{
+  return (_rxPosition < _rxData.size()) ? _rxData[_rxPosition++] : -1;
+}
+
+// ---- Arduino core ----
+
+unsigned long millis( void )  { return _now; }
+unsigned long micros( void )  { return _now * 1000 + _busTimeUs; }
+void delay( unsigned long ms )  { _now += ms; }
+void delayMicroseconds( unsigned int us )  { (void) us; }
+static void checkTwiPin( int pin )  { if ((pin == _twiScl) || (pin == _twiSda))  _twiPinConflicts++; }
+void pinMode( int pin, int mode )  { (void) mode; checkTwiPin(pin); }
+void digitalWrite( int pin, int value )  { (void) value; checkTwiPin(pin); }
+int  digitalRead( int pin )  { (void) pin; return HIGH; }    // buttons released, SDA idle
+long map( long x, long inMin, long inMax, long outMin, long outMax )  { return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin; }
+long random( long max )  { return rand() % max; }
+void noInterrupts( void )  {}
+void interrupts( void )  {}
+
+void  RFduino_ULPDelay( uint64_t ms )
+{
+  if (_pinWoke)  return;          // a latched pin wake ends every wait at once
+  if (ms == INFINITE)  ms = 1;    // no wake source is simulated
+  if (_wakeInterval && (ms > _wakeInterval))  ms = _wakeInterval;
+  _now += ms;
+  _sleepTime += ms;
+}
+void  RFduino_pinWake( int pin, int level )  { (void) level; _pinWakeEnabled |= 1UL << pin; }
+int   RFduino_pinWoke( int pin )  { return (_pinWoke >> pin) & 1; }
+void  RFduino_resetPinWake( int pin )  { _pinWoke &= ~(1UL << pin); }
+float RFduino_temperature( int scale )  { (void) scale; return 24.0f; }
+
+int Print::printf( const char *format, ... )
+{
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (n > (int) sizeof(buf) - 1)  n = sizeof(buf) - 1;
+  for (int i = 0; i < n; i++)  write((uint8_t) buf[i]);
+  return n;
+}
+
+size_t HardwareSerial::write( uint8_t c )
+{
+  if (_serialEcho)  putchar(c);
+  return 1;
+}
+
+bool RFduinoBLEClass::send( const char *data, int length )
+{
+  if (length > RFDUINO_BLE_MAX_PACKET)  return false;
+  _blePackets.push_back(std::string(data, length));
+  return true;
+}
+
+// ---- SD card ----
+
+int File::read( void *buf, uint16_t length )
+{
+  int n = 0;
+  while (_data && (n < length) && (_position < _data->size()))  {
+    ((uint8_t *) buf)[n++] = (*_data)[_position++];
+  }
+  return n;
+}
+
+size_t File::write( uint8_t c )
+{
+  if (!_data)  return 0;
+  if (_position < _data->size())  (*_data)[_position] = c;
+  else  _data->push_back(c);
+  _position++;
+  return 1;
+}
+
+bool File::seek( uint32_t position )
+{
+  if (!_data || (position > _data->size()))  return false;
+  _position = position;
+  return true;
+}
+
+bool SDClass::exists( const char *name )
+{
+  return _files.count(name) != 0;
+}
+
+File SDClass::open( const char *name, int mode )
+{
+  if ((mode == FILE_READ) && !exists(name))  return File();
+  SimFileData *data = &_files[name];
+  return File(data, (mode == FILE_WRITE) ? data->size() : 0);
+}
+
+bool SDClass::remove( const char *name )
+{
+  return _files.erase(name) != 0;
+}
+
+// ---- bench control ----
+
+void simReset( void )
+{
+  _now = 0;
+  _busTimeUs = 0;
+  _sleepTime = 0;
+  _wakeInterval = 0;
+  _pinWakeEnabled = 0;
+  _pinWoke = 0;
+  _i2cTransactions = 0;
+  _failCount = 0;
+  _twiScl = _twiSda = -1;
+  _twiPinConflicts = 0;
+  _blePackets.clear();
+  _files.clear();
+
+  // 4 sensors behind the multiplexer, from the brightest near detector to the darkest far detector
+  static const double light[4] = { 0.5, 0.05, 0.002, 0.0001 };
+  for (uint8_t i = 0; i < SIM_NUMBER_OF_SENSORS; i++)  {
+    _tsl[i].reset();
+    _tsl[i].present = i < 4;
+    _tsl[i].light = (i < 4) ? light[i] : 0;
+  }
+  _muxSelect = 0;
+
+  memset(_maxReg, 0, sizeof(_maxReg));
+  for (uint8_t port = 28; port < MAX6956_PORTS; port++)  _maxReg[MAX6956_PORT + port] = 1;    // buttons released, not charging
+  for (uint8_t port = 0; port < MAX6956_PORTS; port++)  _ledLight[port] = 0;
+
+  memset(_fgReg, 0, sizeof(_fgReg));
+  simSetFuelGauge(0xC800, 0x5080);    // 4.0 V, 80.5 %
+  _fgReg[0x0C] = 0x97;                // CONFIG power-on value
+  _fgReg[0x0D] = 0x1C;
+}
+
+uint32_t simNow( void )  { return _now; }
+uint32_t simGetSleepTime( void )  { return _sleepTime; }
+uint32_t simGetI2CTransactions( void )  { return _i2cTransactions; }
+uint32_t simGetTwiPinConflicts( void )  { return _twiPinConflicts; }
+void simSetWakeInterval( uint32_t ms )  { _wakeInterval = ms; }
+void simWakePin( int pin )  { if (_pinWakeEnabled & (1UL << pin))  _pinWoke |= 1UL << pin; }
+
+void simSetLight( uint8_t sensor, double level )  { _tsl[sensor].light = level; }
+void simSetLedLight( uint8_t port, double level )  { _ledLight[port] = level; }
+void simSetSensorPresent( uint8_t sensor, bool present )  { _tsl[sensor].present = present; }
+
+void simFailTransactions( uint8_t address, int count )
+{
+  _failAddress = address;
+  _failCount = count;
+}
+
+void simSetFuelGauge( uint16_t vcellRegister, uint16_t socRegister )
+{
+  _fgReg[0x02] = vcellRegister >> 8;
+  _fgReg[0x03] = vcellRegister & 0xFF;
+  _fgReg[0x04] = socRegister >> 8;
+  _fgReg[0x05] = socRegister & 0xFF;
+  // ALRT is set once the SoC drops below 32 % - ATHD, and stays set until the firmware clears it
+  if ((socRegister >> 8) < 32 - (_fgReg[0x0D] & 0x1F))  _fgReg[0x0D] |= 0x20;
+}
+
+void simSetSerialEcho( bool echo )  { _serialEcho = echo; }
+
+const std::vector<std::string> &simGetBlePackets( void )  { return _blePackets; }
+void simClearBlePackets( void )  { _blePackets.clear(); }
+
+SimFileData *simGetFile( const char *name )
+{
+  std::map<std::string, SimFileData>::iterator it = _files.find(name);
+  return (it == _files.end()) ? 0 : &it->second;
+}
@@ -0,0 +1,51 @@
+/* Simulator.h
+bench simulator for the host tests: a millisecond clock, the I2C devices of the wearable board
+(PCA9548 multiplexer, 8 TSL2591 channels, MAX6956, MAX17043), BLE packets and an in-memory SD card
+Time only advances through the firmware's own waits (delay, RFduino_ULPDelay) and the I2C bus time.
+*/
+
+#ifndef _SIMULATOR_H_
+#define _SIMULATOR_H_
+
+#include <Arduino.h>
+#include <SD.h>
+#include <string>
+#include <vector>
+
+#define SIM_NUMBER_OF_SENSORS     8       // multiplexer channels
+#define SIM_BUS_TIME_PER_BYTE     90      // us, 100 kHz including ACK
+#define SIM_BUS_TIME_PER_START    20      // us per transaction
+#define SIM_TSL2591_AVALID_DELAY  2       // ms after the nominal integration time until AVALID is set
+
+#define SIM_ADDR_ANY              0xFF    // simFailTransactions(): any device
+
+void      simReset( void );       // power-on state of all devices, clock at 0, default light levels
+uint32_t  simNow( void );         // ms
+uint32_t  simGetSleepTime( void );      // ms spent in RFduino_ULPDelay()
+uint32_t  simGetI2CTransactions( void );
+// pinMode()/digitalWrite() calls on SCL or SDA while the I2C peripheral was enabled and owned them
+uint32_t  simGetTwiPinConflicts( void );
+// RFduino_ULPDelay() returns after at most ms, as if a wake event occurred, 0 for no wake events
+void      simSetWakeInterval( uint32_t ms );
+// an edge on a pin RFduino_pinWake() enabled: latches RFduino_pinWoke(), RFduino_ULPDelay() returns at once until it is reset
+void      simWakePin( int pin );
+
+// light level of a sensor channel in counts per (gain x ms), the ADC value is level * gain * integration time
+void      simSetLight( uint8_t sensor, double level );
+// added to the light level of every sensor while the MAX6956 drives the given port
+void      simSetLedLight( uint8_t port, double level );
+void      simSetSensorPresent( uint8_t sensor, bool present );
+// the next count transactions to the address are NACKed, SIM_ADDR_ANY for any device
+void      simFailTransactions( uint8_t address, int count );
+
+// raises the low SoC alert against the alert threshold in CONFIG, like the MAX17043
+void      simSetFuelGauge( uint16_t vcellRegister, uint16_t socRegister );
+
+void      simSetSerialEcho( bool echo );    // print the firmware's serial output on stdout
+
+const std::vector<std::string> &simGetBlePackets( void );
+void      simClearBlePackets( void );
+
+SimFileData  *simGetFile( const char *name );     // 0 if the file does not exist
+
+#endif
@@ -0,0 +1,28 @@
+#!/usr/bin/env python3
+# Turns a sketch into a C++ file the way the Arduino builder does: <Arduino.h> first and
+# prototypes for the sketch's top-level functions before the first function definition.
+# Usage: prepare_sketch.py sketch.ino > sketch.cpp
+import re
+import sys
+
+FUNCTION = re.compile(r'^(?:static\s+)?([A-Za-z_][\w:<>]*\s*\**)\s+\**([A-Za-z_]\w*)\s*\(([^;{]*)\)\s*\{?\s*$')
+
+path = sys.argv[1]
+lines = open(path).read().split('\n')
+prototypes = []
+first = None
+depth = 0
+for i, line in enumerate(lines):
+    if depth == 0 and not line[:1].isspace():
+        m = FUNCTION.match(line)
+        if m and m.group(1).strip() not in ('return', 'else', 'typedef'):
+            prototypes.append('%s %s(%s);' % (m.group(1).strip(), m.group(2), m.group(3)))
+            if first is None:
+                first = i
+    depth += line.count('{') - line.count('}')
+
+if first is None:
+    first = len(lines)
+out = ['#include <Arduino.h>', '#line 1 "%s"' % path] + lines[:first] + prototypes \
+    + ['#line %d "%s"' % (first + 1, path)] + lines[first:]
+print('\n'.join(out))
@@ -0,0 +1,95 @@
+/* Arduino.h
+host stand-in for the RFduino core, only what the firmware uses
+The functions are implemented by the bench simulator in test/Simulator.cpp.
+*/
+
+#ifndef _ARDUINO_STUB_H_
+#define _ARDUINO_STUB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+#define CELSIUS         0
+#define INFINITE        0xFFFFFFFF
+
+unsigned long millis( void );
+unsigned long micros( void );
+void delay( unsigned long ms );
+void delayMicroseconds( unsigned int us );
+void pinMode( int pin, int mode );
+void digitalWrite( int pin, int value );
+int  digitalRead( int pin );
+long map( long x, long inMin, long inMax, long outMin, long outMax );
+long random( long max );
+void noInterrupts( void );
+void interrupts( void );
+
+// RFduino extensions
+void  RFduino_ULPDelay( uint64_t ms );
+void  RFduino_pinWake( int pin, int level );
+int   RFduino_pinWoke( int pin );
+void  RFduino_resetPinWake( int pin );
+float RFduino_temperature( int scale );
+
+class String : public std::string
+{
+  public:
+    String() {}
+    String( const char *s ) : std::string(s) {}
+    String( const std::string &s ) : std::string(s) {}
+    explicit String( int value )  { char b[16]; snprintf(b, sizeof(b), "%d", value); assign(b); }
+    long toInt( void ) const  { return atol(c_str()); }
+    void toCharArray( char *buf, unsigned int n ) const  { strncpy(buf, c_str(), n); if (n)  buf[n - 1] = 0; }
+    String &operator+=( const char *s )  { append(s); return *this; }
+    String &operator+=( char c )  { push_back(c); return *this; }
+    String &operator+=( const String &s )  { append(s); return *this; }
+};
+inline String operator+( const char *a, const String &b )  { return String(std::string(a) + std::string(b)); }
+inline String operator+( const String &a, const char *b )  { return String(std::string(a) + b); }
+
+// text output goes through write(), so a derived class (serial port, file) only has to store bytes
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write( uint8_t c ) = 0;
+    size_t write( const uint8_t *data, size_t n )  { for (size_t i = 0; i < n; i++)  write(data[i]); return n; }
+    size_t print( const char *s )  { return printf("%s", s); }
+    size_t print( char c )  { return printf("%c", c); }
+    size_t print( int v, int base = 10 )  { return (base == 16) ? printf("%x", v) : printf("%d", v); }
+    size_t print( unsigned int v, int base = 10 )  { return (base == 16) ? printf("%x", v) : printf("%u", v); }
+    size_t print( long v, int base = 10 )  { return (base == 16) ? printf("%lx", v) : printf("%ld", v); }
+    size_t print( unsigned long v, int base = 10 )  { return (base == 16) ? printf("%lx", v) : printf("%lu", v); }
+    size_t print( double v, int digits = 2 )  { return printf("%.*f", digits, v); }
+    size_t print( const String &s )  { return printf("%s", s.c_str()); }
+    size_t println( void )  { return printf("\n"); }
+    template <class T> size_t println( T v )  { size_t n = print(v); return n + println(); }
+    template <class T> size_t println( T v, int base )  { size_t n = print(v, base); return n + println(); }
+    int printf( const char *format, ... ) __attribute__((format(printf, 2, 3)));
+};
+
+// serial output is dropped unless the simulator echoes it, see simSetSerialEcho()
+class HardwareSerial : public Print
+{
+  public:
+    void   begin( long baud )  { (void) baud; }
+    int    available( void )  { return 0; }
+    int    read( void )  { return -1; }
+    size_t write( uint8_t c );
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
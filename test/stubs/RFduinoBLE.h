@@ -0,0 +1,24 @@
+/* RFduinoBLE.h
+host stand-in for the RFduino BLE stack, sent packets are kept by test/Simulator.cpp
+*/
+
+#ifndef _RFDUINO_BLE_STUB_H_
+#define _RFDUINO_BLE_STUB_H_
+
+#include <Arduino.h>
+
+#define RFDUINO_BLE_MAX_PACKET   20     // bytes per notification
+
+class RFduinoBLEClass
+{
+  public:
+    const char  *deviceName;
+    const char  *advertisementData;
+
+    int   begin( void )  { return 0; }
+    bool  send( const char *data, int length );
+};
+
+extern RFduinoBLEClass RFduinoBLE;
+
+#endif
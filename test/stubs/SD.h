@@ -0,0 +1,61 @@
+/* SD.h
+host stand-in for the Arduino SD library, files live in memory in test/Simulator.cpp
+*/
+
+#ifndef _SD_STUB_H_
+#define _SD_STUB_H_
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define FILE_READ       0
+#define FILE_WRITE      1
+#define SPI_HALF_SPEED  1
+
+typedef std::vector<uint8_t>  SimFileData;
+
+class File : public Print
+{
+  public:
+    File() : _data(0), _position(0) {}
+    File( SimFileData *data, uint32_t position ) : _data(data), _position(position) {}
+
+    operator bool() const  { return _data != 0; }
+    void      close( void )  {}
+    void      flush( void )  {}
+    int       available( void )  { return _data ? (int) (_data->size() - _position) : 0; }
+    int       peek( void )  { return (_data && (_position < _data->size())) ? (*_data)[_position] : -1; }
+    int       read( void )  { return (_data && (_position < _data->size())) ? (*_data)[_position++] : -1; }
+    int       read( void *buf, uint16_t length );
+    size_t    write( uint8_t c );
+    size_t    write( const uint8_t *data, size_t length )  { for (size_t i = 0; i < length; i++)  write(data[i]); return length; }
+    size_t    write( const char *s )  { return write((const uint8_t *) s, strlen(s)); }
+    uint32_t  size( void )  { return _data ? _data->size() : 0; }
+    uint32_t  position( void )  { return _position; }
+    bool      seek( uint32_t position );
+
+  private:
+    SimFileData  *_data;
+    uint32_t      _position;
+};
+
+class SDClass
+{
+  public:
+    bool  begin( int chipSelect )  { (void) chipSelect; return true; }
+    bool  exists( const char *name );
+    File  open( const char *name, int mode = FILE_READ );
+    bool  remove( const char *name );
+};
+
+extern SDClass SD;
+
+class Sd2Card
+{
+  public:
+    bool  init( int speed, int chipSelect )  { (void) speed; (void) chipSelect; return true; }
+};
+
+#endif
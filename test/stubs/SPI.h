@@ -0,0 +1,10 @@
+/* SPI.h
+host stand-in, the SD card stub does not need SPI
+*/
+
+#ifndef _SPI_STUB_H_
+#define _SPI_STUB_H_
+
+#include <Arduino.h>
+
+#endif
@@ -0,0 +1,31 @@
+/* Wire.h
+host stand-in for the RFduino I2C library, the transactions go to the simulated devices of test/Simulator.cpp
+*/
+
+#ifndef _WIRE_STUB_H_
+#define _WIRE_STUB_H_
+
+#include <Arduino.h>
+
+#define BUFFER_LENGTH   32
+
+class TwoWire
+{
+  public:
+    void     begin( void );
+    void     beginOnPins( int sclPin, int sdaPin );
+    void     end( void );
+    void     beginTransmission( uint8_t address );
+    size_t   write( uint8_t data );
+    size_t   write( const uint8_t *data, size_t length );
+    uint8_t  endTransmission( void );
+    uint8_t  endTransmission( uint8_t sendStop );
+    uint8_t  requestFrom( uint8_t address, uint8_t length );
+    uint8_t  requestFrom( int address, int length )  { return requestFrom((uint8_t) address, (uint8_t) length); }
+    int      available( void );
+    int      read( void );
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,250 @@
+/* test_acquisition.cpp
+non-blocking acquisition state machine of Sensor_TSL2591 against the simulated clock
+*/
+
+#include "Simulator.h"
+#include "Check.h"
+#include "Sensor_TSL2591.h"
+
+typedef Sensor_TSL2591<4, 3, 3>  TestSensor;
+
+// simulated time base that counts the low-power waits
+class TestClock : public Clock
+{
+  public:
+    TestClock() : waits(0) {}
+    uint32_t  now( void )  { return simNow(); }
+    uint32_t  waits;
+
+  protected:
+    void  lowPowerWait( uint32_t ms )  { waits++; Clock::lowPowerWait(ms); }
+};
+
+// expected ADC count of a simulated sensor at the power-on setting of begin(): 9876x gain, 100 ms
+static uint16_t expectedCount( double level )
+{
+  double counts = level * 9876 * 100;
+  return (counts > TSL2591_OVERFLOW_100MS) ? TSL2591_OVERFLOW_100MS : (uint16_t) counts;
+}
+
+static void beginSensor( TestSensor &tsl )
+{
+  simReset();
+  I2C.begin(PIN_WIRE_SCL, PIN_WIRE_SDA, PIN_I2C_MUX_RESET);
+  CHECK(tsl.begin());
+}
+
+// run the acquisition the way loop() does: poll, sleep for the idle time, poll again
+static uint32_t runAcquisition( TestSensor &tsl, TestClock &clock, uint8_t LEDpattern, uint16_t *polls )
+{
+  uint32_t start = clock.now();
+  CHECK(tsl.beginAcquisition(LEDpattern, start));
+  CHECK(tsl.isAcquisitionRunning());
+  *polls = 0;
+  while (!tsl.poll(clock.now()))  {
+    (*polls)++;
+    clock.sleep(tsl.getIdleTime(clock.now()));
+    if (*polls > 1000)  break;
+  }
+  CHECK(!tsl.isAcquisitionRunning());
+  CHECK_EQUAL(TSL2591_ACQ_DONE, tsl.getAcquisitionState());
+  CHECK(!tsl.poll(clock.now()));      // new data is reported only once
+  return clock.now() - start;
+}
+
+static void checkSamples( TestSensor &tsl )
+{
+  static const double light[4] = { 0.5, 0.05, 0.002, 0.0001 };
+  for (uint8_t i = 0; i < 4; i++)  {
+    CHECK(tsl.isSampleValid(i));
+    CHECK(tsl.isNewSampleAvailable(i));
+    CHECK_EQUAL(expectedCount(light[i]), tsl.getFullSpecSignal(i));
+    CHECK_EQUAL(expectedCount(light[i]) / 3, tsl.getIRSpecSignal(i));
+    CHECK(!tsl.isNewSampleAvailable(i));
+  }
+  CHECK_EQUAL(0x0F, tsl.getValidSensors());
+}
+
+// the blocking wrapper runs the same state machine and sleeps through the clock it is given
+static void testBlockingAcquisition( void )
+{
+  TestSensor tsl;
+  TestClock clock;
+  beginSensor(tsl);
+  tsl.setClock(&clock);
+  uint32_t start = clock.now();
+  tsl.startAcquisition(0);
+  uint32_t duration = clock.now() - start;
+
+  CHECK_EQUAL(TSL2591_ACQ_DONE, tsl.getAcquisitionState());
+  CHECK(duration >= INTEGRATION_TIME_WAIT_STEP);
+  CHECK(duration < INTEGRATION_TIME_WAIT_STEP + 10);
+  CHECK(clock.waits > 0);
+  checkSamples(tsl);
+}
+
+// fixed wait: new data exactly once, after the worst-case time, with only a few wake-ups in between
+static void testFixedWait( void )
+{
+  TestSensor tsl;
+  TestClock clock;
+  beginSensor(tsl);
+  uint16_t polls;
+  uint32_t sleepTime = simGetSleepTime();
+  uint32_t duration = runAcquisition(tsl, clock, 1, &polls);
+
+  CHECK(duration >= INTEGRATION_TIME_WAIT_STEP);
+  CHECK(duration < INTEGRATION_TIME_WAIT_STEP + 10);
+  CHECK(polls <= 4);
+  CHECK(duration - (simGetSleepTime() - sleepTime) < 10);    // the bus time, everything else is slept
+  CHECK_EQUAL(1, tsl.getCurrentLEDpattern());
+  checkSamples(tsl);
+}
+
+// status wait: read out on AVALID instead of the worst-case time
+static void testStatusWait( void )
+{
+  TestSensor tsl;
+  TestClock clock;
+  beginSensor(tsl);
+  tsl.setWaitMode(TSL2591_WAIT_STATUS);
+  uint16_t polls;
+  uint32_t start = clock.now();
+  runAcquisition(tsl, clock, 0, &polls);
+
+  for (uint8_t i = 0; i < 4; i++)  {
+    CHECK(tsl.getSampleTime(i) - start >= INTEGRATION_TIME_STEP + SIM_TSL2591_AVALID_DELAY);
+    CHECK(tsl.getSampleTime(i) - start < INTEGRATION_TIME_WAIT_STEP);
+  }
+  CHECK_EQUAL(0, tsl.getStatusTimeoutCount());
+  checkSamples(tsl);
+}
+
+// a second acquisition can't start while one runs, and the state machine only moves with poll()
+static void testStateSequence( void )
+{
+  TestSensor tsl;
+  beginSensor(tsl);
+  CHECK_EQUAL(TSL2591_ACQ_IDLE, tsl.getAcquisitionState());
+  CHECK(!tsl.beginAcquisition(3, simNow()));          // no such LED pattern
+  CHECK(tsl.beginAcquisition(0, simNow()));
+  CHECK(!tsl.beginAcquisition(0, simNow()));
+  CHECK_EQUAL(TSL2591_ACQ_CONFIGURE, tsl.getAcquisitionState());
+  CHECK_EQUAL(0, tsl.getIdleTime(simNow()));
+  CHECK(!tsl.poll(simNow()));
+  CHECK_EQUAL(TSL2591_ACQ_ENABLE, tsl.getAcquisitionState());
+  CHECK(!tsl.poll(simNow()));
+  CHECK_EQUAL(TSL2591_ACQ_INTEGRATING, tsl.getAcquisitionState());
+
+  uint32_t idle = tsl.getIdleTime(simNow());
+  CHECK(idle > INTEGRATION_TIME_WAIT_STEP - 10);
+  CHECK(idle <= INTEGRATION_TIME_WAIT_STEP);
+  delay(idle - 1);
+  CHECK(!tsl.poll(simNow()));
+  CHECK_EQUAL(TSL2591_ACQ_INTEGRATING, tsl.getAcquisitionState());
+  delay(1);
+  CHECK(!tsl.poll(simNow()));
+  CHECK_EQUAL(TSL2591_ACQ_READOUT, tsl.getAcquisitionState());
+  CHECK(tsl.poll(simNow()));
+  checkSamples(tsl);
+}
+
+// the auto-gain of an LED pattern follows the validity of that pattern's last readout, not of the last readout overall
+static void testPatternValidity( void )
+{
+  TestSensor tsl;
+  beginSensor(tsl);
+
+  // the near detector saturates at the power-on setting, three samples fill the history of pattern 0
+  for (uint8_t i = 0; i < 3; i++)  tsl.startAcquisition(0);
+  CHECK(tsl.isSampleValid(0));
+
+  // every readout of pattern 1 fails
+  simFailTransactions(SIM_ADDR_ANY, 1000);
+  tsl.startAcquisition(1);
+  simFailTransactions(SIM_ADDR_ANY, 0);
+  CHECK(!tsl.isSampleValid(0));
+  CHECK(!tsl.autoAdjustGain(1));
+
+  // pattern 0 still has a complete, valid history and switches down
+  uint8_t iGI = GainIntegrationIndex[tsl.getGainIndex(0)][tsl.getIntegrationTimeIndex(0)];
+  CHECK(tsl.autoAdjustGain(0));
+  tsl.startAcquisition(0);
+  CHECK(tsl.isSampleValid(0));
+  CHECK_EQUAL(iGI - 1, GainIntegrationIndex[tsl.getGainIndex(0)][tsl.getIntegrationTimeIndex(0)]);
+}
+
+// the bus recovery clocks SCL and SDA by hand only after the I2C peripheral released them, and restarts it
+static void testBusRecovery( void )
+{
+  TestSensor tsl;
+  beginSensor(tsl);
+  uint16_t recoveries = I2C.getRecoveryCount();
+  simFailTransactions(SIM_ADDR_ANY, I2C_RECOVERY_THRESHOLD * I2C_MAX_ATTEMPTS);
+  tsl.startAcquisition(0);
+  CHECK(I2C.getRecoveryCount() != recoveries);
+  CHECK_EQUAL(0, simGetTwiPinConflicts());
+
+  // the peripheral is back on its pins
+  pinMode(PIN_WIRE_SDA, INPUT);
+  CHECK_EQUAL(1, simGetTwiPinConflicts());
+  tsl.startAcquisition(0);
+  CHECK(tsl.isSampleValid(0));
+}
+
+// one staggered acquisition the way loop() runs it, returns the number of intermediate samples of a sensor
+static uint8_t runStaggered( TestSensor &tsl, uint8_t LEDpattern, uint8_t sensor )
+{
+  uint8_t intermediate = 0;
+  CHECK(tsl.beginAcquisition(LEDpattern, simNow()));
+  while (!tsl.poll(simNow()))  {
+    if (tsl.isNewSampleAvailable(sensor) && tsl.isIntermediateSample(sensor))  {
+      intermediate++;
+      if (intermediate > 1)  CHECK(!tsl.isGainSwitchSample(sensor));
+      tsl.getFullSpecSignal(sensor);
+    }
+    RFduino_ULPDelay(tsl.getIdleTime(simNow()));
+  }
+  CHECK(!tsl.isIntermediateSample(sensor));     // the frame sample comes last
+  return intermediate;
+}
+
+// staggered mode: the near detector is sampled several times per frame, but only its frame samples go into
+// the past signal buffer, so the stepwise auto-gain still averages NUM_PAST_SIGNAL_VALUES frames
+static void testStaggeredHistory( void )
+{
+  TestSensor tsl;
+  beginSensor(tsl);
+  tsl.setWaitMode(TSL2591_WAIT_STATUS);
+  tsl.setScheduleMode(TSL2591_SCHEDULE_STAGGERED);
+
+  // settle: the near detector ends up at a short, the far detector at the longest integration time
+  tsl.setGainMode(TSL2591_GAIN_PREDICTIVE);
+  for (uint8_t i = 0; i < 10; i++)  {
+    runStaggered(tsl, 0, 0);
+    tsl.autoAdjustGain(0);
+  }
+  CHECK(tsl.getIntegrationTimeIndex(0) < tsl.getIntegrationTimeIndex(3));
+
+  // the near detector saturates now, the stepwise switch down needs three frames
+  simSetLight(0, 50);
+  tsl.setGainMode(TSL2591_GAIN_STEPWISE);
+  uint8_t iGI = GainIntegrationIndex[tsl.getGainIndex(0)][tsl.getIntegrationTimeIndex(0)];
+  for (uint8_t frame = 1; frame <= 3; frame++)  {
+    CHECK(runStaggered(tsl, 0, 0) >= 1);
+    CHECK_EQUAL(frame == 3, tsl.autoAdjustGain(0));
+  }
+  CHECK_EQUAL(iGI - 1, GainIntegrationIndex[tsl.getGainIndex(0)][tsl.getIntegrationTimeIndex(0)]);
+}
+
+int main( void )
+{
+  testBlockingAcquisition();
+  testFixedWait();
+  testStatusWait();
+  testStateSequence();
+  testPatternValidity();
+  testBusRecovery();
+  testStaggeredHistory();
+  return checkResult();
+}
@@ -0,0 +1,78 @@
+/* test_ambient_filter.cpp
+AmbientFilter dark frame subtraction: linear interpolation between the dark frames, and invalid samples
+(failed or absent sensor, 0 counts) left out instead of being subtracted or interpolated as light
+*/
+
+#include "Check.h"
+#include "AmbientFilter.h"
+
+typedef AmbientFilter<2, 3>  TestFilter;
+
+static void addFrame( TestFilter *filter, uint8_t LEDpattern, uint32_t time, uint32_t signal0, uint32_t signal1, uint8_t validSensors,
+                      boolean expectCorrected )
+{
+  uint32_t signal[2] = { signal0, signal1 };
+  uint32_t sampleTime[2] = { time, time };
+  CHECK_EQUAL(expectCorrected, filter->addFrame(LEDpattern, signal, sampleTime, validSensors));
+}
+
+// ambient rising from 100 to 200 between the dark frames is subtracted at the illuminated sample times
+static void testInterpolation( void )
+{
+  TestFilter filter(0);
+  addFrame(&filter, 1, 0, 5000, 5000, 0x03, false);        // before the first dark frame, never corrected
+  addFrame(&filter, 0, 1000, 100, 100, 0x03, false);
+  addFrame(&filter, 1, 1250, 1125, 2125, 0x03, false);
+  addFrame(&filter, 2, 1500, 3150, 150, 0x03, false);
+  addFrame(&filter, 0, 2000, 200, 200, 0x03, true);
+
+  CHECK(filter.isCorrected(1));
+  CHECK(filter.isCorrected(2));
+  CHECK(!filter.isCorrected(0));
+  CHECK_EQUAL(0x03, filter.getValidSensors(1));
+  CHECK_EQUAL(1000, filter.getCorrectedSignal(1, 0));
+  CHECK_EQUAL(2000, filter.getCorrectedSignal(1, 1));
+  CHECK_EQUAL(3000, filter.getCorrectedSignal(2, 0));
+  CHECK_EQUAL(0, filter.getCorrectedSignal(2, 1));        // below the ambient light, clamped
+}
+
+static void testInvalidSamples( void )
+{
+  TestFilter filter(0);
+  addFrame(&filter, 0, 1000, 100, 0, 0x01, false);         // sensor 1 absent: no dark sample yet
+  addFrame(&filter, 1, 1250, 1100, 0, 0x01, false);
+  addFrame(&filter, 2, 1500, 0, 900, 0x02, false);         // sensor 0 failed in the LED2 frame
+  addFrame(&filter, 0, 2000, 100, 100, 0x03, true);
+  CHECK_EQUAL(0x01, filter.getValidSensors(1));
+  CHECK_EQUAL(1000, filter.getCorrectedSignal(1, 0));
+  CHECK_EQUAL(0, filter.getCorrectedSignal(1, 1));
+  // sensor 1 has no dark sample before LED2, sensor 0 no LED2 sample
+  CHECK_EQUAL(0x00, filter.getValidSensors(2));
+  CHECK_EQUAL(0, filter.getCorrectedSignal(2, 0));
+  CHECK_EQUAL(0, filter.getCorrectedSignal(2, 1));
+
+  // a failed dark sample: the frames before it have no correction for that sensor ...
+  addFrame(&filter, 1, 2250, 1100, 1100, 0x03, false);
+  addFrame(&filter, 0, 3000, 5000, 0, 0x01, true);
+  CHECK_EQUAL(0x01, filter.getValidSensors(1));
+  CHECK_EQUAL(0, filter.getCorrectedSignal(1, 1));
+  // ... and the next ones are interpolated from the last valid dark sample, not from the 0 counts
+  addFrame(&filter, 1, 3500, 5500, 1300, 0x03, false);
+  addFrame(&filter, 0, 4000, 5000, 300, 0x03, true);
+  CHECK_EQUAL(0x03, filter.getValidSensors(1));
+  CHECK_EQUAL(500, filter.getCorrectedSignal(1, 0));
+  CHECK_EQUAL(1300 - 250, filter.getCorrectedSignal(1, 1));
+
+  filter.reset();
+  addFrame(&filter, 0, 5000, 100, 100, 0x03, false);
+  addFrame(&filter, 1, 5250, 1100, 1100, 0x03, false);
+  addFrame(&filter, 0, 6000, 100, 100, 0x03, true);
+  CHECK_EQUAL(0x03, filter.getValidSensors(1));
+}
+
+int main( void )
+{
+  testInterpolation();
+  testInvalidSamples();
+  return checkResult();
+}
@@ -0,0 +1,243 @@
+/* test_auto_gain_replay.cpp
+integer auto-gain decisions of Sensor_TSL2591 against the float implementation they replaced
+The float reference below is the code of autoAdjustGain(), predictGainIntTime(), calcOptimal_iGI(),
+SwitchUpMultiplier() and isOverflow() before the decisions became integer-only.
+Allowed deviation: where the exact prediction of the predictive mode lands on the overflow limit, the
+integer path counts it as an overflow (the comparison is >=) and stays one iGI lower. The float product
+can round just below the limit there. No other decision may differ.
+*/
+
+#include "Simulator.h"
+#include "Check.h"
+#include "Sensor_TSL2591.h"
+
+#define NUM_SENSORS         4
+#define NUM_PATTERNS        3
+#define NUM_PAST_VALUES     3
+#define REPLAY_FILE         "fixtures/auto_gain_replay.txt"
+
+typedef Sensor_TSL2591<NUM_SENSORS, NUM_PATTERNS, NUM_PAST_VALUES>  TestSensor;
+
+// ---- float reference ----
+
+static boolean floatIsOverflow( float sensorVal, uint8_t intTimeIndex )
+{
+  if (intTimeIndex == 0)  return sensorVal >= 0x9400;
+  return sensorVal >= 0xFFFF;
+}
+
+static uint8_t clamp_iGI( int iGI )
+{
+  if (iGI <= 0)  return 0;
+  if (iGI >= TSL2591_MAX_iGI)  return TSL2591_MAX_iGI;
+  return iGI;
+}
+
+static float floatPastValueAverage( uint32_t sum )
+{
+  float pastValAvg = sum;
+  pastValAvg /= NUM_PAST_VALUES;
+  return pastValAvg;
+}
+
+static boolean floatSwitchDown( uint32_t sum, uint8_t iGI )
+{
+  return floatIsOverflow(floatPastValueAverage(sum) + AUTO_GAIN_SWITCH_BUFFER, iGI_IntegrationTimeIndex[iGI]);
+}
+
+static boolean floatSwitchUp( uint32_t sum, uint8_t iGI )
+{
+  uint8_t up_iGI = clamp_iGI(iGI + 1);
+  float m = (float) GainIntegrationProduct[up_iGI] / GainIntegrationProduct[iGI];
+  float predictedSwitchUpValue = floatPastValueAverage(sum) * m;
+  return floatIsOverflow(predictedSwitchUpValue + AUTO_GAIN_SWITCH_BUFFER, iGI_IntegrationTimeIndex[up_iGI]) == false;
+}
+
+static uint8_t floatOptimal_iGI( float sensorVal, uint8_t iGI )
+{
+  for (uint8_t new_iGI = TSL2591_MAX_iGI; new_iGI > 0; new_iGI--)  {
+    float predictedValue = sensorVal * GainIntegrationProduct[new_iGI] / GainIntegrationProduct[iGI];
+    if (floatIsOverflow(predictedValue + AUTO_GAIN_SWITCH_BUFFER, iGI_IntegrationTimeIndex[new_iGI]) == false)  return new_iGI;
+  }
+  return 0;
+}
+
+// auto-gain state of all sensors and LED patterns, decided in float
+class FloatAutoGain
+{
+  public:
+    uint8_t   iGI[NUM_SENSORS][NUM_PATTERNS];
+    uint16_t  switches;
+
+    FloatAutoGain( uint8_t initial_iGI )
+    {
+      switches = 0;
+      for (uint8_t s = 0; s < NUM_SENSORS; s++)  {
+        for (uint8_t p = 0; p < NUM_PATTERNS; p++)  {
+          iGI[s][p] = initial_iGI;
+          _count[s][p] = 0;
+        }
+      }
+    }
+
+    void push( uint8_t s, uint8_t p, uint16_t value )
+    {
+      for (uint8_t i = NUM_PAST_VALUES - 1; i > 0; i--)  _values[s][p][i] = _values[s][p][i - 1];
+      _values[s][p][0] = value;
+      if (_count[s][p] < NUM_PAST_VALUES)  _count[s][p]++;
+    }
+
+    void adjust( uint8_t p, tsl2591GainMode_t gainMode )
+    {
+      for (uint8_t s = 0; s < NUM_SENSORS; s++)  {
+        if ((gainMode == TSL2591_GAIN_PREDICTIVE) && (_count[s][p] > 0) && predict(s, p))  {
+          _count[s][p] = 0;
+          continue;
+        }
+        if (_count[s][p] < NUM_PAST_VALUES)  continue;
+
+        uint32_t sum = 0;
+        for (uint8_t i = 0; i < NUM_PAST_VALUES; i++)  sum += _values[s][p][i];
+        if (floatSwitchDown(sum, iGI[s][p]))  {
+          switchTo(s, p, clamp_iGI(iGI[s][p] - 1));
+        }
+        else if (floatSwitchUp(sum, iGI[s][p]))  {
+          switchTo(s, p, clamp_iGI(iGI[s][p] + 1));
+        }
+      }
+    }
+
+  private:
+    uint16_t  _values[NUM_SENSORS][NUM_PATTERNS][NUM_PAST_VALUES];    // index 0 is the newest
+    uint8_t   _count[NUM_SENSORS][NUM_PATTERNS];
+
+    boolean predict( uint8_t s, uint8_t p )
+    {
+      uint16_t lastValue = _values[s][p][0];
+      uint8_t current = iGI[s][p];
+      uint8_t new_iGI;
+      if (floatIsOverflow(lastValue, iGI_IntegrationTimeIndex[current]))  new_iGI = 0;
+      else  new_iGI = floatOptimal_iGI(lastValue, current);
+      if ((new_iGI + 1 >= current) && (new_iGI <= current + 1))  return false;
+      if (new_iGI != current)  switches++;
+      iGI[s][p] = new_iGI;
+      return true;
+    }
+
+    void switchTo( uint8_t s, uint8_t p, uint8_t new_iGI )
+    {
+      if (new_iGI != iGI[s][p])  switches++;
+      iGI[s][p] = new_iGI;
+      _count[s][p] = 0;
+    }
+};
+
+// ---- exhaustive comparison of the decisions ----
+
+// every iGI and every sum of NUM_PAST_VALUES 16 bit values: switch down, switch up or stay
+static void testStepwiseDecisions( TestSensor &tsl )
+{
+  uint32_t decisions = 0;
+  uint32_t differences = 0;
+  for (uint8_t iGI = 0; iGI < TSL2591_NUMBER_OF_iGI; iGI++)  {
+    uint8_t up_iGI = clamp_iGI(iGI + 1);
+    for (uint32_t sum = 0; sum <= NUM_PAST_VALUES * 0xFFFFUL; sum++)  {
+      boolean down = tsl.isPredictedOverflow(sum, NUM_PAST_VALUES, iGI, iGI);
+      decisions++;
+      if (down != floatSwitchDown(sum, iGI))  differences++;
+      if (down)  continue;
+      boolean up = !tsl.isPredictedOverflow(sum, NUM_PAST_VALUES, iGI, up_iGI);
+      decisions++;
+      if (up != floatSwitchUp(sum, iGI))  differences++;
+    }
+  }
+  printf("stepwise: %u decisions, %u differ\n", decisions, differences);
+  CHECK_EQUAL(0, differences);
+}
+
+// every iGI and every 16 bit value: the iGI the predictive mode jumps to
+static void testPredictiveDecisions( TestSensor &tsl )
+{
+  uint32_t decisions = 0;
+  uint32_t ties = 0;
+  for (uint8_t iGI = 0; iGI < TSL2591_NUMBER_OF_iGI; iGI++)  {
+    for (uint32_t value = 0; value <= 0xFFFF; value++)  {
+      uint8_t integer_iGI = tsl.calcOptimal_iGI(value, iGI);
+      uint8_t float_iGI = floatOptimal_iGI(value, iGI);
+      decisions++;
+      if (integer_iGI == float_iGI)  continue;
+
+      // the only allowed difference: the exact prediction at the float's choice equals the limit
+      uint32_t limit = ((iGI_IntegrationTimeIndex[float_iGI] == 0) ? TSL2591_OVERFLOW_100MS : TSL2591_OVERFLOW) - AUTO_GAIN_SWITCH_BUFFER;
+      boolean tie = (float_iGI > integer_iGI)
+                    && ((uint64_t) value * GainIntegrationProduct[float_iGI] == (uint64_t) limit * GainIntegrationProduct[iGI]);
+      if (tie)  ties++;
+      else  {
+        fprintf(stderr, "value %u at iGI %u: integer iGI %u, float iGI %u\n", value, iGI, integer_iGI, float_iGI);
+        CHECK(tie);
+      }
+    }
+  }
+  printf("predictive: %u decisions, %u differ on an exact tie with the limit\n", decisions, ties);
+  CHECK_EQUAL(9, ties);
+}
+
+// ---- replay through the driver ----
+
+static uint16_t replay( tsl2591GainMode_t gainMode )
+{
+  FILE *file = fopen(REPLAY_FILE, "r");
+  CHECK(file != 0);
+  if (!file)  return 0;
+
+  TestSensor tsl;
+  simReset();
+  I2C.begin(PIN_WIRE_SCL, PIN_WIRE_SDA, PIN_I2C_MUX_RESET);
+  CHECK(tsl.begin());
+  tsl.setGainMode(gainMode);
+  FloatAutoGain reference(GainIntegrationIndex[tsl.getGainIndex(0)][tsl.getIntegrationTimeIndex(0)]);
+
+  char line[128];
+  uint16_t frame = 0;
+  uint16_t mismatches = 0;
+  while (fgets(line, sizeof(line), file))  {
+    double level[NUM_SENSORS];
+    if (line[0] == '#')  continue;
+    if (sscanf(line, "%lf %lf %lf %lf", &level[0], &level[1], &level[2], &level[3]) != NUM_SENSORS)  continue;
+
+    uint8_t pattern = frame % NUM_PATTERNS;
+    for (uint8_t s = 0; s < NUM_SENSORS; s++)  simSetLight(s, level[s]);
+    tsl.startAcquisition(pattern);
+    for (uint8_t s = 0; s < NUM_SENSORS; s++)  {
+      CHECK(tsl.isSampleValid(s));
+      reference.push(s, pattern, tsl.getFullSpecSignal(s));
+    }
+    tsl.autoAdjustGain(pattern);
+    reference.adjust(pattern, gainMode);
+
+    for (uint8_t s = 0; s < NUM_SENSORS; s++)  {
+      uint8_t iGI = GainIntegrationIndex[tsl.getGainIndex(s)][tsl.getIntegrationTimeIndex(s)];
+      if (iGI != reference.iGI[s][pattern])  {
+        if (mismatches == 0)  fprintf(stderr, "frame %u sensor %u: iGI %u, float reference %u\n", frame, s, iGI, reference.iGI[s][pattern]);
+        mismatches++;
+      }
+    }
+    frame++;
+  }
+  fclose(file);
+  printf("replay %s: %u frames, %u switches, %u mismatches\n", (gainMode == TSL2591_GAIN_PREDICTIVE) ? "predictive" : "stepwise",
+         frame, reference.switches, mismatches);
+  CHECK(frame > 500);
+  CHECK_EQUAL(0, mismatches);
+  return reference.switches;
+}
+
+int main( void )
+{
+  TestSensor tsl;
+  testStepwiseDecisions(tsl);
+  testPredictiveDecisions(tsl);
+  CHECK(replay(TSL2591_GAIN_STEPWISE) > 50);
+  CHECK(replay(TSL2591_GAIN_PREDICTIVE) > 20);
+  return checkResult();
+}
@@ -0,0 +1,76 @@
+/* test_auto_gain_settle.cpp
+time the wearable sketch needs to settle its gains from the power-on setting, predictive vs stepwise auto-gain
+*/
+
+#include "Simulator.h"
+#include "Check.h"
+#include "Sensor_TSL2591.h"
+#include "LedBoard.h"
+
+extern Sensor_TSL2591<4, NUMBER_OF_LED_PATTERNS, 3>  Tsl;
+void setup( void );
+void loop( void );
+void RFduinoBLE_onConnect( void );
+void RFduinoBLE_onReceive( char *data, int len );
+
+#define SETTLE_RUN_TIME   60000     // ms
+
+typedef struct
+{
+  uint32_t  lastSwitchTime;                         // ms after setup()
+  uint16_t  switches[NUMBER_OF_LED_PATTERNS];       // gain switches of all sensors per LED pattern
+  uint16_t  maxSensorSwitches;                      // most switches of one sensor in one LED pattern
+} settleResult_t;
+
+// streaming during a workout, so the cycles run back to back
+static void runSketch( tsl2591GainMode_t gainMode, settleResult_t *result )
+{
+  uint16_t sensorSwitches[4][NUMBER_OF_LED_PATTERNS] = {{0}};
+  memset(result, 0, sizeof(*result));
+
+  simReset();
+  setup();
+  Tsl.setGainMode(gainMode);
+  RFduinoBLE_onConnect();
+  char workout = '4';
+  RFduinoBLE_onReceive(&workout, 1);
+
+  uint32_t start = simNow();
+  Trace.clear();
+  while (simNow() - start < SETTLE_RUN_TIME)  {
+    loop();
+    traceRecord_t record;
+    for (uint8_t i = 0; Trace.get(i, &record); i++)  {
+      if ((record.event != TRACE_GAIN_UP) && (record.event != TRACE_GAIN_DOWN))  continue;
+      result->lastSwitchTime = record.time - start;
+      result->switches[record.LEDpattern]++;
+      sensorSwitches[record.sensor][record.LEDpattern]++;
+    }
+    Trace.clear();
+  }
+  for (uint8_t i = 0; i < 4; i++)  {
+    for (uint8_t p = 0; p < NUMBER_OF_LED_PATTERNS; p++)  {
+      if (sensorSwitches[i][p] > result->maxSensorSwitches)  result->maxSensorSwitches = sensorSwitches[i][p];
+    }
+  }
+}
+
+int main( void )
+{
+  settleResult_t predictive;
+  settleResult_t stepwise;
+  runSketch(TSL2591_GAIN_PREDICTIVE, &predictive);
+  runSketch(TSL2591_GAIN_STEPWISE, &stepwise);
+
+  printf("predictive: settled after %u ms, at most %u switches per sensor and pattern\n", predictive.lastSwitchTime, predictive.maxSensorSwitches);
+  printf("stepwise:   settled after %u ms, at most %u switches per sensor and pattern\n", stepwise.lastSwitchTime, stepwise.maxSensorSwitches);
+
+  CHECK(predictive.lastSwitchTime < 5000);
+  CHECK(predictive.maxSensorSwitches <= 2);
+  CHECK(stepwise.lastSwitchTime > 20000);
+  CHECK(stepwise.lastSwitchTime < SETTLE_RUN_TIME - 5000);    // it did settle within the run
+  for (uint8_t p = 0; p < NUMBER_OF_LED_PATTERNS; p++)  {
+    CHECK(predictive.switches[p] > 0);
+  }
+  return checkResult();
+}
@@ -0,0 +1,77 @@
+/* test_hdr_signal.cpp
+gain-normalized HDR output of Sensor_TSL2591: a constant light level gives the same HDR value at every gain/integration time
+*/
+
+#include "Simulator.h"
+#include "Check.h"
+#include "Sensor_TSL2591.h"
+
+typedef Sensor_TSL2591<4, 1, 3>  TestSensor;
+
+static const double Light[4] = { 0.5, 0.05, 0.002, 0.0001 };
+
+// the Q16 table against the exact ratio
+static void testScaleTable( void )
+{
+  for (uint8_t iGI = 0; iGI < TSL2591_NUMBER_OF_iGI; iGI++)  {
+    double exact = 65536.0 * GainIntegrationProduct[TSL2591_MAX_iGI] / GainIntegrationProduct[iGI];
+    CHECK(HDRScale[iGI] >= exact - 0.5);
+    CHECK(HDRScale[iGI] <= exact + 0.5);
+  }
+  CHECK_EQUAL(65536, HDRScale[TSL2591_MAX_iGI]);
+}
+
+// stepwise auto-gain through a light step down and back up walks every sensor through several settings,
+// the HDR value follows the light level independent of the setting the sample was taken at
+static void testLightSteps( void )
+{
+  TestSensor tsl;
+  simReset();
+  I2C.begin(PIN_WIRE_SCL, PIN_WIRE_SDA, PIN_I2C_MUX_RESET);
+  CHECK(tsl.begin());
+
+  uint32_t settings[4] = { 0 };       // bit mask of the iGIs each sensor sampled at
+  uint8_t last_iGI[4];
+  for (uint8_t s = 0; s < 4; s++)  last_iGI[s] = 0xFF;
+
+  static const double Step[3] = { 1.0, 1.0 / 30, 1.0 };
+  for (uint16_t frame = 0; frame < 300; frame++)  {
+    double factor = Step[frame / 100];
+    for (uint8_t s = 0; s < 4; s++)  simSetLight(s, Light[s] * factor);
+    tsl.startAcquisition(0);
+    for (uint8_t s = 0; s < 4; s++)  {
+      uint8_t iGI = GainIntegrationIndex[tsl.getGainIndex(s)][tsl.getIntegrationTimeIndex(s)];
+      uint16_t counts = tsl.getFullSpecSignal(s);
+      if (iGI != last_iGI[s])  CHECK(tsl.isGainSwitchSample(s));
+      last_iGI[s] = iGI;
+      uint16_t saturation = (iGI_IntegrationTimeIndex[iGI] == 0) ? TSL2591_OVERFLOW_100MS : TSL2591_OVERFLOW;
+      if ((counts >= saturation) || (counts < 100))  continue;    // saturated or too coarse
+
+      // the ADC truncates, so the HDR value may be low by up to one count scaled to 9876x/600 ms
+      double expected = Light[s] * factor * GainIntegrationProduct[TSL2591_MAX_iGI];
+      double step = (double) HDRScale[iGI] / 65536;
+      double hdr = tsl.getHDRSignal(s, TSL2591_FULLSPECTRUM);
+      CHECK(hdr <= expected + 1);
+      CHECK(hdr >= expected - step - 1);
+      settings[s] |= 1UL << iGI;
+    }
+    tsl.autoAdjustGain();
+  }
+
+  // every sensor was checked at 3 or more settings
+  uint8_t used[4] = { 0 };
+  for (uint8_t s = 0; s < 4; s++)  {
+    for (uint8_t iGI = 0; iGI < TSL2591_NUMBER_OF_iGI; iGI++)  {
+      if (settings[s] & (1UL << iGI))  used[s]++;
+    }
+    printf("sensor %u: HDR checked at %u settings\n", s, used[s]);
+    CHECK(used[s] >= 3);
+  }
+}
+
+int main( void )
+{
+  testScaleTable();
+  testLightSteps();
+  return checkResult();
+}
@@ -0,0 +1,185 @@
+/* test_power.cpp
+share of the time the wearable sketch spends in low-power wait, the frame rate it keeps while doing so,
+and the cycle rate the rate scheduler picks for the workout, idle and low battery states
+*/
+
+#include "Simulator.h"
+#include "Check.h"
+#include "Clock.h"
+#include "RateScheduler.h"
+#include "Sensor_TSL2591.h"
+#include "LedBoard.h"
+
+extern Sensor_TSL2591<4, NUMBER_OF_LED_PATTERNS, 3>  Tsl;
+extern RateScheduler Rate;
+void setup( void );
+void loop( void );
+void RFduinoBLE_onConnect( void );
+void RFduinoBLE_onDisconnect( void );
+void RFduinoBLE_onReceive( char *data, int len );
+
+#define POWER_RUN_TIME    60000     // ms
+#define POWER_BUTTON      3         // the sketch's power button pin
+
+typedef struct
+{
+  uint16_t  frames;               // per POWER_RUN_TIME, so per minute
+  uint32_t  runTime;              // ms, POWER_RUN_TIME up to the end of the last wait
+  uint32_t  sleepTime;            // ms in RFduino_ULPDelay() during the run
+  uint32_t  cycleActiveTime;      // ms, sums of the per-cycle counters of SystemClock
+  uint32_t  cycleSleepTime;
+} powerResult_t;
+
+// streaming during a workout, so the cycles run back to back
+static void startWorkout( void )
+{
+  RFduinoBLE_onConnect();
+  char workout = '4';
+  RFduinoBLE_onReceive(&workout, 1);
+}
+
+// not connected and no workout: the decimated profile
+static void stayIdle( void )
+{
+}
+
+// idle, but the full rate pinned with the 'p' command, as before the rate scheduler
+static void pinFullRate( void )
+{
+  char command[2] = { 'p', RATE_PROFILE_FULL };
+  RFduinoBLE_onReceive(command, sizeof(command));
+}
+
+// 10 % state of charge: the minimal profile
+static void lowBattery( void )
+{
+  simSetFuelGauge(0xC800, 0x0A00);
+}
+
+// the sketch's globals outlive a run: its clock must not go back, and the rate scheduler returns to its power-on state
+static uint32_t lastRunEnd = 0;
+
+static void resetSketchState( void )
+{
+  delay(lastRunEnd);
+  RFduinoBLE_onDisconnect();
+  char command[2] = { 'p', (char) RATE_PROFILE_AUTO };
+  RFduinoBLE_onReceive(command, sizeof(command));
+  char stop = '5';
+  RFduinoBLE_onReceive(&stop, 1);
+}
+
+static void runSketch( void (*enterState)( void ), uint32_t wakeInterval, powerResult_t *result )
+{
+  memset(result, 0, sizeof(*result));
+  simReset();
+  resetSketchState();
+  simSetWakeInterval(wakeInterval);
+  setup();
+  enterState();
+
+  uint32_t start = simNow();
+  uint32_t sleepStart = simGetSleepTime();
+  while (simNow() - start < POWER_RUN_TIME)  {
+    size_t sent = simGetBlePackets().size();
+    loop();
+    // a frame starts with the info packet, the intermediate samples of the near detectors come on their own
+    if ((simGetBlePackets().size() == sent) || (simGetBlePackets()[sent][0] != 0))  continue;
+    result->frames++;
+    result->cycleActiveTime += SystemClock.getCycleActiveTime();
+    result->cycleSleepTime += SystemClock.getCycleSleepTime();
+  }
+  result->sleepTime = simGetSleepTime() - sleepStart;
+  result->runTime = simNow() - start;
+  lastRunEnd = simNow();
+}
+
+static void testWorkout( void )
+{
+  powerResult_t lowPower;
+  powerResult_t polled;
+  runSketch(startWorkout, 0, &lowPower);
+  // a wake-up every ms is the old delay(1) polling
+  runSketch(startWorkout, 1, &polled);
+
+  printf("low-power wait: %u frames/min, %.1f%% asleep, per frame %u ms active %u ms asleep\n",
+         lowPower.frames, 100.0 * lowPower.sleepTime / lowPower.runTime,
+         lowPower.cycleActiveTime / lowPower.frames, lowPower.cycleSleepTime / lowPower.frames);
+  printf("1 ms polling:   %u frames/min\n", polled.frames);
+
+  CHECK(lowPower.frames > 0);
+  CHECK(lowPower.sleepTime > lowPower.runTime * 0.95);
+  // the per-cycle counters account for the whole run but the partial first and last cycle
+  CHECK(lowPower.cycleActiveTime + lowPower.cycleSleepTime > POWER_RUN_TIME * 0.95);
+  CHECK(lowPower.cycleSleepTime > lowPower.cycleActiveTime * 20);
+  // sleeping until the next ADC can be done costs at most 1% of the frame rate
+  CHECK(lowPower.frames * 100 >= polled.frames * 99);
+}
+
+static void testRateProfiles( void )
+{
+  powerResult_t full;
+  powerResult_t idle;
+  powerResult_t low;
+  runSketch(pinFullRate, 0, &full);
+  runSketch(stayIdle, 0, &idle);
+  runSketch(lowBattery, 0, &low);
+
+  // the full and decimated profiles acquire all LED patterns, the minimal one dark and LED1
+  uint16_t fullCycles = full.frames / NUMBER_OF_LED_PATTERNS;
+  uint16_t idleCycles = idle.frames / NUMBER_OF_LED_PATTERNS;
+  uint16_t lowCycles = low.frames / 2;
+  printf("idle, full rate: %u cycles/min, %.1f%% asleep\n", fullCycles, 100.0 * full.sleepTime / full.runTime);
+  printf("idle, decimated: %u cycles/min, %.1f%% asleep\n", idleCycles, 100.0 * idle.sleepTime / idle.runTime);
+  printf("low battery:     %u cycles/min, %.1f%% asleep\n", lowCycles, 100.0 * low.sleepTime / low.runTime);
+
+  // one cycle every 5 s, or back to back when it takes longer
+  CHECK(idleCycles >= 11);
+  CHECK(idleCycles <= 13);
+  CHECK(fullCycles > idleCycles * 2);
+  CHECK((double) idle.sleepTime / idle.runTime > (double) full.sleepTime / full.runTime);
+  // one cycle every 15 s
+  CHECK(lowCycles >= 4);
+  CHECK(lowCycles <= 5);
+  CHECK((double) low.sleepTime / low.runTime > (double) idle.sleepTime / idle.runTime);
+}
+
+// a short power button press while the decimated profile idles between cycles: the latched pin wake is
+// reset, so the next waits are slept again instead of returning at once
+static void testPinWakeWhileIdle( void )
+{
+  simReset();
+  resetSketchState();
+  setup();
+  stayIdle();
+  // the first cycle is over and the next one is seconds away
+  uint32_t start = simNow();
+  do  {
+    loop();
+  } while ((simNow() - start < 1000) || Tsl.isAcquisitionRunning() || (Rate.getIdleTime(simNow()) < 2000));
+
+  simWakePin(POWER_BUTTON);
+  uint32_t loops = 0;
+  uint32_t wakeTime = simNow();
+  uint32_t sleepStart = simGetSleepTime();
+  while ((simNow() - wakeTime < 20000) && (loops < 1000000))  {
+    loop();
+    loops++;
+  }
+  uint32_t runTime = simNow() - wakeTime;
+  uint32_t sleepTime = simGetSleepTime() - sleepStart;
+  lastRunEnd = simNow();
+  printf("idle after a pin wake: %u loops in %u ms, %.1f%% asleep\n", loops, runTime, 100.0 * sleepTime / runTime);
+
+  CHECK(runTime >= 20000);
+  CHECK(sleepTime > runTime * 0.95);
+  CHECK(loops < 2000);
+}
+
+int main( void )
+{
+  testWorkout();
+  testRateProfiles();
+  testPinWakeWhileIdle();
+  return checkResult();
+}
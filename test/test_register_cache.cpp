@@ -0,0 +1,91 @@
+/* test_register_cache.cpp
+register caches of the drivers: unchanged registers are not written again, a failed write is not cached
+*/
+
+#include "Simulator.h"
+#include "Check.h"
+#include "Sensor_TSL2591.h"
+#include "LedBoard.h"
+#include "FuelGauge.h"
+
+extern Sensor_TSL2591<4, NUMBER_OF_LED_PATTERNS, 3>  Tsl;
+extern LedDriver  LedDrv;
+extern FuelGauge  Batt;
+void setup( void );
+void loop( void );
+
+static void testRegisterCache( void )
+{
+  RegisterCache<10> cache;
+  CHECK(!cache.isValid(9));
+  CHECK(!cache.isCached(9, 0));
+  cache.store(9, 0x42);
+  CHECK(cache.isCached(9, 0x42));
+  CHECK(!cache.isCached(9, 0x43));
+  CHECK(!cache.isValid(1));
+  cache.invalidate(9);
+  CHECK(!cache.isValid(9));
+  cache.store(1, 0);
+  cache.invalidateAll();
+  CHECK(!cache.isValid(1));
+}
+
+// the same gain/integration time and the same multiplexer channel again cost no bus transaction
+static void testSensorCache( void )
+{
+  Tsl.selectSensor(2);
+  Tsl.selectGain(1);
+  uint32_t transactions = simGetI2CTransactions();
+  Tsl.selectSensor(2);
+  Tsl.selectGain(1);
+  Tsl.selectIntegrationTime(Tsl.getIntegrationTimeIndex(2));
+  CHECK_EQUAL(transactions, simGetI2CTransactions());
+
+  // a write that failed on the bus leaves the register unknown, so the next write goes out
+  simFailTransactions(0x29, I2C_MAX_ATTEMPTS);
+  Tsl.selectGain(2);
+  transactions = simGetI2CTransactions();
+  Tsl.selectGain(2);
+  CHECK(simGetI2CTransactions() > transactions);
+  transactions = simGetI2CTransactions();
+  Tsl.selectGain(2);
+  CHECK_EQUAL(transactions, simGetI2CTransactions());
+
+  Tsl.invalidateRegisterCache();
+  Tsl.selectSensor(2);
+  CHECK_EQUAL(transactions + 1, simGetI2CTransactions());
+}
+
+// I2C transactions per loop() iteration, with the caches or with every cache dropped before each iteration
+static double transactionsPerLoop( bool cached )
+{
+  uint32_t loops = 0;
+  uint32_t transactions = simGetI2CTransactions();
+  uint32_t end = simNow() + 30000;
+  while (simNow() < end)  {
+    if (!cached)  {
+      Tsl.invalidateRegisterCache();
+      LedDrv.invalidateRegisterCache();
+      Batt.invalidateRegisterCache();
+    }
+    loop();
+    loops++;
+  }
+  return (double) (simGetI2CTransactions() - transactions) / loops;
+}
+
+int main( void )
+{
+  testRegisterCache();
+
+  simReset();
+  setup();
+  for (uint16_t i = 0; i < 200; i++)  loop();
+  double cached = transactionsPerLoop(true);
+  double uncached = transactionsPerLoop(false);
+  printf("I2C transactions per loop: %.2f cached, %.2f uncached\n", cached, uncached);
+  CHECK(cached < uncached * 0.95);
+
+  testSensorCache();
+  return checkResult();
+}
@@ -0,0 +1,49 @@
+/* test_ring_buffer.cpp
+RingBuffer against a plain shifted history array with a recomputed sum, the code it replaced in Sensor_TSL2591
+*/
+
+#include "Check.h"
+#include "RingBuffer.h"
+
+template <uint8_t SIZE>
+static void compareWithShiftedArray( uint32_t operations )
+{
+  RingBuffer<uint16_t, SIZE> ring;
+  uint16_t history[SIZE];     // index 0 is the newest value
+  uint8_t recorded = 0;
+
+  srand(SIZE);
+  for (uint32_t i = 0; i < operations; i++)  {
+    if (rand() % 20 == 0)  {
+      ring.clear();
+      recorded = 0;
+    }
+    else  {
+      uint16_t value = (rand() % 4 == 0) ? 0xFFFF : rand() & 0xFFFF;    // saturated values test the sum range
+      ring.push(value);
+      for (uint8_t k = SIZE - 1; k > 0; k--)  history[k] = history[k - 1];
+      history[0] = value;
+      if (recorded < SIZE)  recorded++;
+    }
+
+    uint32_t sum = 0;
+    for (uint8_t k = 0; k < recorded; k++)  {
+      sum += history[k];
+      CHECK_EQUAL(history[k], ring.get(k));
+    }
+    CHECK_EQUAL(recorded, ring.count());
+    CHECK_EQUAL(recorded == SIZE, ring.isFull());
+    CHECK_EQUAL(sum, ring.sum());
+    if (recorded > 0)  CHECK_EQUAL(history[0], ring.newest());
+    if (checkFailures > 0)  return;
+  }
+}
+
+int main( void )
+{
+  compareWithShiftedArray<1>(10000);
+  compareWithShiftedArray<3>(100000);
+  compareWithShiftedArray<8>(100000);
+  compareWithShiftedArray<255>(20000);
+  return checkResult();
+}
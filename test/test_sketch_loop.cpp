@@ -0,0 +1,400 @@
+/* test_sketch_loop.cpp
+setup() and loop() of the wearable sketch on the bench: loop() only sends packets when poll() reports a new frame,
+or when the staggered acquisition read out an intermediate sample. By default only the ambient corrected frames
+are sent, the 'r' command adds the raw frames and samples. The log always holds the raw and the corrected frames,
+with 'r' the samples as well.
+The sketch's globals outlive a test, so the tests run in this order.
+*/
+
+#include <stddef.h>
+#include <SD.h>
+#include "Simulator.h"
+#include "Check.h"
+#include "Sensor_TSL2591.h"
+#include "LedBoard.h"
+#include "LogFormat.h"
+
+extern Sensor_TSL2591<4, NUMBER_OF_LED_PATTERNS, 3>  Tsl;
+extern char wfilename[];
+void setup( void );
+void loop( void );
+void RFduinoBLE_onConnect( void );
+void RFduinoBLE_onReceive( char *data, int len );
+
+static uint16_t countPackets( uint8_t infoByte )
+{
+  uint16_t count = 0;
+  const std::vector<std::string> &packets = simGetBlePackets();
+  for (size_t i = 0; i < packets.size(); i++)  {
+    if ((uint8_t) packets[i][0] == infoByte)  count++;
+  }
+  return count;
+}
+
+static uint32_t getLE32( const std::string &data, size_t offset )
+{
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < 4; i++)  value |= (uint32_t) (uint8_t) data[offset + i] << (8 * i);
+  return value;
+}
+
+static uint16_t getLE16( const std::string &data, size_t offset )
+{
+  return (uint8_t) data[offset] | ((uint16_t) (uint8_t) data[offset + 1] << 8);
+}
+
+// the sketch's globals outlive a test, so its clock must not go back
+static void restartSketch( void )
+{
+  uint32_t now = simNow();
+  simReset();
+  delay(now);
+  setup();
+}
+
+static void sendCommand( char command )
+{
+  RFduinoBLE_onReceive(&command, 1);
+}
+
+// count the records of each type in the log file, false if there is no valid log file
+static bool countRecords( uint16_t *records )
+{
+  for (uint8_t i = 0; i <= LOG_RECORD_CORRECTED; i++)  records[i] = 0;
+  SimFileData *file = simGetFile(wfilename);
+  CHECK(file != 0);
+  if (!file)  return false;
+  CHECK(file->size() > sizeof(logFileHeader_t));
+  CHECK_EQUAL(LOG_FORMAT_VERSION, (*file)[offsetof(logFileHeader_t, version)]);
+  CHECK_EQUAL(0, (file->size() - sizeof(logFileHeader_t)) % sizeof(logRecord_t));
+
+  for (size_t pos = sizeof(logFileHeader_t); pos + sizeof(logRecord_t) <= file->size(); pos += sizeof(logRecord_t))  {
+    logRecord_t record;
+    memcpy(&record, &(*file)[pos], sizeof(record));
+    CHECK(record.recordType <= LOG_RECORD_CORRECTED);
+    if (record.recordType > LOG_RECORD_CORRECTED)  continue;
+    records[record.recordType]++;
+    if (record.recordType == LOG_RECORD_SAMPLE)  {
+      CHECK(record.sampleSensor < 4);
+      CHECK_EQUAL(1 << record.sampleSensor, record.validSensors);
+    }
+    if (record.recordType == LOG_RECORD_CORRECTED)  {
+      CHECK(record.LEDpattern != LED_PATTERN_DARK);
+      for (uint8_t i = 0; i < 4; i++)  {
+        CHECK_EQUAL(0, record.sensor[i]);
+        CHECK_EQUAL(0, record.ir[i]);
+        CHECK_EQUAL(0, record.gainIntTime[i]);
+      }
+    }
+    else  {
+      for (uint8_t i = 0; i < 4; i++)  CHECK_EQUAL(0, record.corrected[i]);
+    }
+  }
+  return true;
+}
+
+// power-on default: per frame the info packet, per cycle one corrected packet for each illuminated LED pattern
+static void testCorrectedOnly( void )
+{
+  restartSketch();
+  CHECK_EQUAL(0x0F, Tsl.getPresentSensors());
+
+  uint16_t frames = 0;
+  uint32_t start = simNow();
+  while (simNow() - start < 20000)  {
+    size_t sent = simGetBlePackets().size();
+    loop();
+    if (simGetBlePackets().size() == sent)  continue;
+    frames++;
+    CHECK_EQUAL(0, simGetBlePackets()[sent][0]);
+    for (size_t i = sent + 1; i < simGetBlePackets().size(); i++)  {
+      CHECK_EQUAL(3, simGetBlePackets()[i][0]);
+    }
+  }
+  CHECK(frames >= 6);
+  CHECK_EQUAL(frames, countPackets(0));
+  // every dark frame but the first completes the two illuminated frames before it
+  CHECK(countPackets(3) >= 2 * (frames / NUMBER_OF_LED_PATTERNS - 1));
+  CHECK(countPackets(3) <= 2 * (frames / NUMBER_OF_LED_PATTERNS + 1));
+}
+
+// raw frames on: the frame and sample packets loop() sends while idle
+static void testRawPackets( void )
+{
+  restartSketch();
+  sendCommand('r');
+
+  uint32_t loops = 0;
+  uint16_t frames = 0;
+  uint16_t samples[4] = { 0 };
+  uint32_t lastSampleTime[4] = { 0 };
+  uint32_t start = simNow();
+  while (simNow() - start < 20000)  {
+    size_t sent = simGetBlePackets().size();
+    loop();
+    loops++;
+    if (simGetBlePackets().size() == sent)  continue;
+
+    // intermediate samples: infoByte 4, sensor, LED pattern, gain/integration time, time, signal, IR, valid
+    if (simGetBlePackets()[sent][0] == 4)  {
+      for (size_t i = sent; i < simGetBlePackets().size(); i++)  {
+        const std::string &sample = simGetBlePackets()[i];
+        CHECK_EQUAL(4, sample[0]);
+        uint8_t sensor = sample[1];
+        CHECK(sensor < 4);
+        if (sensor >= 4)  continue;
+        uint32_t time = getLE32(sample, 4);
+        CHECK(time > lastSampleTime[sensor]);
+        CHECK(time <= simNow());
+        CHECK_EQUAL(1, sample[12]);
+        lastSampleTime[sensor] = time;
+        samples[sensor]++;
+      }
+      continue;
+    }
+
+    // a frame: the info packet first, then the detector and IR packets of the frame's LED pattern
+    frames++;
+    const std::string &info = simGetBlePackets()[sent];
+    CHECK_EQUAL(0, info[0]);
+    CHECK(simGetBlePackets().size() >= sent + 3);
+    CHECK_EQUAL(1, simGetBlePackets()[sent + 1][0]);
+    CHECK_EQUAL(2, simGetBlePackets()[sent + 2][0]);
+  }
+
+  CHECK(frames >= 6);
+  CHECK_EQUAL(frames, countPackets(0));
+  CHECK_EQUAL(frames, countPackets(1));
+  CHECK(loops > frames);            // loop() returns while the sensors integrate
+  // the near detector settles at a short integration time and is sampled several times per frame,
+  // the far detector needs the longest one and only delivers frame samples
+  CHECK(samples[0] > frames);
+  CHECK_EQUAL(0, samples[3]);
+}
+
+// raw frames on during a workout: every frame, intermediate sample and corrected frame sent over BLE is logged as well
+static void testRawLog( void )
+{
+  restartSketch();
+  RFduinoBLE_onConnect();
+  sendCommand('4');
+  simClearBlePackets();
+  uint32_t start = simNow();
+  while (simNow() - start < 20000)  loop();
+
+  uint16_t records[LOG_RECORD_CORRECTED + 1];
+  if (!countRecords(records))  return;
+  // the last frame or sample may have been sent before its record was written, or the other way round
+  CHECK(records[LOG_RECORD_SAMPLE] > 0);
+  CHECK(records[LOG_RECORD_SAMPLE] + 1 >= countPackets(4));
+  CHECK(records[LOG_RECORD_SAMPLE] <= countPackets(4) + 1);
+  CHECK(records[LOG_RECORD_FRAME] + 1 >= countPackets(0));
+  CHECK(records[LOG_RECORD_FRAME] <= countPackets(0) + 1);
+  CHECK(records[LOG_RECORD_CORRECTED] > 0);
+  CHECK(records[LOG_RECORD_CORRECTED] + 2 >= countPackets(3));
+  CHECK(records[LOG_RECORD_CORRECTED] <= countPackets(3) + 2);
+}
+
+// back to corrected frames only: the log holds the raw frames the App reads and the corrected frames,
+// each corrected record has the values of its corrected packet
+static void testCorrectedLog( void )
+{
+  restartSketch();
+  sendCommand('c');
+  RFduinoBLE_onConnect();
+  sendCommand('4');
+  simClearBlePackets();
+  uint32_t start = simNow();
+  while (simNow() - start < 20000)  loop();
+
+  CHECK_EQUAL(0, countPackets(1));
+  CHECK_EQUAL(0, countPackets(4));
+  uint16_t records[LOG_RECORD_CORRECTED + 1];
+  if (!countRecords(records))  return;
+  CHECK(records[LOG_RECORD_FRAME] + 1 >= countPackets(0));
+  CHECK(records[LOG_RECORD_FRAME] <= countPackets(0) + 1);
+  CHECK_EQUAL(0, records[LOG_RECORD_SAMPLE]);
+  CHECK(records[LOG_RECORD_CORRECTED] > 0);
+  CHECK_EQUAL(countPackets(3), records[LOG_RECORD_CORRECTED]);
+
+  // logging and sending started with the '4' command, so the corrected records and packets are in step
+  const std::vector<std::string> &packets = simGetBlePackets();
+  SimFileData *file = simGetFile(wfilename);
+  size_t pos = sizeof(logFileHeader_t);
+  for (size_t i = 0; i < packets.size(); i++)  {
+    if (packets[i][0] != 3)  continue;
+    logRecord_t record;
+    do  {
+      memcpy(&record, &(*file)[pos], sizeof(record));
+      pos += sizeof(record);
+    } while (record.recordType != LOG_RECORD_CORRECTED);
+    CHECK_EQUAL((uint8_t) packets[i][1], record.LEDpattern);
+    CHECK_EQUAL((uint8_t) packets[i][2], record.validSensors);
+    CHECK_EQUAL(0x0F, record.validSensors);
+    for (uint8_t s = 0; s < 4; s++)  CHECK_EQUAL(getLE32(packets[i], 4 + 4 * s), record.corrected[s]);
+  }
+}
+
+// the packet a sync sends next must have this infoByte, false at the end of the packets
+static bool nextPacket( size_t *i, uint8_t infoByte )
+{
+  const std::vector<std::string> &packets = simGetBlePackets();
+  CHECK(*i < packets.size());
+  if (*i >= packets.size())  return false;
+  CHECK_EQUAL(infoByte, (uint8_t) packets[*i][0]);
+  (*i)++;
+  return (uint8_t) packets[*i - 1][0] == infoByte;
+}
+
+// sync of the log a workout wrote with the 'c' (default) or 'r' setting: every record goes out as the packets
+// loop() sends live, a frame as info, detector and IR packets, a sample as a sample packet, a corrected frame
+// as a corrected packet
+static void checkSync( char setting )
+{
+  restartSketch();
+  sendCommand(setting);
+  RFduinoBLE_onConnect();
+  sendCommand('4');
+  uint32_t start = simNow();
+  while (simNow() - start < 20000)  loop();
+  char filename[30];
+  strcpy(filename, wfilename);
+  sendCommand('5');
+
+  File tracker = SD.open("tracker.txt", FILE_WRITE);
+  tracker.print("filename = ");
+  tracker.print(filename);
+  tracker.println(";");
+  tracker.close();
+
+  simClearBlePackets();
+  sendCommand('s');
+  const std::vector<std::string> &packets = simGetBlePackets();
+  size_t end = 0;
+  start = simNow();
+  while ((end == 0) && (simNow() - start < 20000))  {
+    loop();
+    for (size_t i = 0; i < packets.size(); i++)  {
+      if ((uint8_t) packets[i][0] == 42)  end = i;
+    }
+  }
+  CHECK(end > 0);
+
+  // the packets between the sync start (32) and the end of the file (29)
+  size_t i = 0;
+  while ((i < packets.size()) && ((uint8_t) packets[i][0] != 32))  i++;
+  i++;
+  SimFileData *file = simGetFile(filename);
+  CHECK(file != 0);
+  if (!file)  return;
+  uint16_t records[LOG_RECORD_CORRECTED + 1] = { 0 };
+  for (size_t pos = sizeof(logFileHeader_t); pos + sizeof(logRecord_t) <= file->size(); pos += sizeof(logRecord_t))  {
+    logRecord_t record;
+    memcpy(&record, &(*file)[pos], sizeof(record));
+    if (!nextPacket(&i, 6))  return;
+    if (record.recordType == LOG_RECORD_SAMPLE)  {
+      if (!nextPacket(&i, 4))  return;
+      const std::string &sample = packets[i - 1];
+      uint8_t s = record.sampleSensor;
+      CHECK(s < 4);
+      if (s >= 4)  return;
+      CHECK_EQUAL(s, (uint8_t) sample[1]);
+      CHECK_EQUAL(record.LEDpattern, (uint8_t) sample[2]);
+      CHECK_EQUAL(record.gainIntTime[s], (uint8_t) sample[3]);
+      CHECK_EQUAL(record.time, getLE32(sample, 4));
+      CHECK_EQUAL(record.sensor[s], getLE16(sample, 8));
+      CHECK_EQUAL(record.ir[s], getLE16(sample, 10));
+      CHECK_EQUAL(1, sample[12]);
+    }
+    else if (record.recordType == LOG_RECORD_CORRECTED)  {
+      if (!nextPacket(&i, 3))  return;
+      const std::string &corrected = packets[i - 1];
+      CHECK_EQUAL(record.LEDpattern, (uint8_t) corrected[1]);
+      CHECK_EQUAL(record.validSensors, (uint8_t) corrected[2]);
+      for (uint8_t s = 0; s < 4; s++)  CHECK_EQUAL(record.corrected[s], getLE32(corrected, 4 + 4 * s));
+    }
+    else  {
+      if (!nextPacket(&i, 0))  return;
+      CHECK_EQUAL(record.time, getLE32(packets[i - 1], 4));
+      if (!nextPacket(&i, 1))  return;
+      const std::string &detector = packets[i - 1];
+      CHECK_EQUAL(record.LEDpattern, (uint8_t) detector[1]);
+      for (uint8_t s = 0; s < 4; s++)  {
+        CHECK_EQUAL(record.sensor[s], getLE16(detector, 2 + 4 * s));
+        CHECK_EQUAL(record.gainIntTime[s] >> LOG_GAIN_SHIFT, (uint8_t) detector[4 + 4 * s]);
+      }
+      if (!nextPacket(&i, 2))  return;
+      for (uint8_t s = 0; s < 4; s++)  CHECK_EQUAL(record.ir[s], getLE16(packets[i - 1], 2 + 2 * s));
+    }
+    if (record.recordType <= LOG_RECORD_CORRECTED)  records[record.recordType]++;
+  }
+  nextPacket(&i, 29);
+  CHECK(records[LOG_RECORD_FRAME] > 0);
+  if (setting == 'r')  CHECK(records[LOG_RECORD_SAMPLE] > 0);
+  else  CHECK_EQUAL(0, records[LOG_RECORD_SAMPLE]);
+  CHECK(records[LOG_RECORD_CORRECTED] > 0);
+}
+
+static void testSyncDefaultLog( void )
+{
+  checkSync('c');
+}
+
+static void testSyncRawLog( void )
+{
+  checkSync('r');
+}
+
+// SD card status of the last info packet
+static uint8_t lastSDCardStatus( void )
+{
+  const std::vector<std::string> &packets = simGetBlePackets();
+  for (size_t i = packets.size(); i > 0; i--)  {
+    if (packets[i - 1][0] == 0)  return packets[i - 1][1];
+  }
+  return 0xFF;
+}
+
+static size_t runWorkout( uint32_t time )
+{
+  uint32_t start = simNow();
+  while (simNow() - start < time)  loop();
+  SimFileData *file = simGetFile(wfilename);
+  return file ? file->size() : 0;
+}
+
+// a critical cell voltage pauses the SD log of a running workout (status 9), it resumes (status 4) on the charger
+static void testCriticalBatteryPause( void )
+{
+  restartSketch();
+  RFduinoBLE_onConnect();
+  sendCommand('4');
+  size_t logged = runWorkout(10000);
+  CHECK(logged > 0);
+  CHECK_EQUAL(4, lastSDCardStatus());
+
+  simSetFuelGauge(0xAA00, 0x0500);      // 3.4 V, 5 %
+  size_t pauseStart = runWorkout(20000);
+  CHECK_EQUAL(9, lastSDCardStatus());
+  size_t paused = runWorkout(20000);
+  CHECK_EQUAL(9, lastSDCardStatus());
+  CHECK_EQUAL(pauseStart, paused);
+
+  simSetFuelGauge(0xC800, 0x5080);      // charger: 4.0 V, 80.5 %
+  size_t resumed = runWorkout(20000);
+  CHECK_EQUAL(4, lastSDCardStatus());
+  CHECK(resumed > paused);
+  sendCommand('5');
+}
+
+int main( void )
+{
+  testCorrectedOnly();
+  testRawPackets();
+  testRawLog();
+  testCorrectedLog();
+  testSyncDefaultLog();
+  testSyncRawLog();
+  testCriticalBatteryPause();
+  return checkResult();
+}
@@ -0,0 +1,172 @@
+/* sdlog2txt.cpp
+converts a binary SD log of the wearable (wearable_device/LogFormat.h) to the text format of the OS X App log file
+Build on the host:  c++ -O2 -o sdlog2txt sdlog2txt.cpp
+Usage:              sdlog2txt [-a] log_0.bin [log_0.txt]      writes to stdout without an output file
+By default only the frames are converted, the App reads nothing else. -a adds the intermediate sample and
+ambient corrected records, with keys of their own.
+*/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "../../wearable_device/LogFormat.h"
+
+#define MAX_RECORD_SIZE   255     // recordSize is a uint8_t
+
+// the log is little endian, the fields are decoded byte by byte so the host byte order does not matter
+static uint16_t getLE16( const uint8_t *data )
+{
+  return data[0] | (data[1] << 8);
+}
+
+static uint32_t getLE32( const uint8_t *data )
+{
+  return (uint32_t)getLE16(data) | ((uint32_t)getLE16(data + 2) << 16);
+}
+
+static bool readHeader( FILE *in, logFileHeader_t *header )
+{
+  uint8_t data[sizeof(logFileHeader_t)];
+  if (fread(data, 1, sizeof(data), in) != sizeof(data))  {
+    fprintf(stderr, "file too short for a log header\n");
+    return false;
+  }
+  memcpy(header->magic, data + offsetof(logFileHeader_t, magic), LOG_FORMAT_MAGIC_LENGTH);
+  header->version = data[offsetof(logFileHeader_t, version)];
+  header->headerSize = data[offsetof(logFileHeader_t, headerSize)];
+  header->recordSize = data[offsetof(logFileHeader_t, recordSize)];
+  header->numberOfSensors = data[offsetof(logFileHeader_t, numberOfSensors)];
+  header->numberOfLedPatterns = data[offsetof(logFileHeader_t, numberOfLedPatterns)];
+  memcpy(header->sensorDistance, data + offsetof(logFileHeader_t, sensorDistance), LOG_NUMBER_OF_SENSORS);
+
+  if (memcmp(header->magic, LOG_FORMAT_MAGIC, LOG_FORMAT_MAGIC_LENGTH) != 0)  {
+    fprintf(stderr, "not a binary log file\n");
+    return false;
+  }
+  // newer versions only append fields, the version 1 fields stay where they are. corrected[] came with version 3
+  size_t recordSize = (header->version >= 3) ? sizeof(logRecord_t) : offsetof(logRecord_t, corrected);
+  if ((header->version < 1) || (header->headerSize < sizeof(logFileHeader_t)) || (header->recordSize < recordSize)
+      || (header->numberOfSensors != LOG_NUMBER_OF_SENSORS))  {
+    fprintf(stderr, "unsupported log format version %d, record size %d, %d sensors\n",
+            header->version, header->recordSize, header->numberOfSensors);
+    return false;
+  }
+  if (header->version > LOG_FORMAT_VERSION)  {
+    fprintf(stderr, "log format version %d, fields after version %d are ignored\n", header->version, LOG_FORMAT_VERSION);
+  }
+  return fseek(in, header->headerSize, SEEK_SET) == 0;
+}
+
+// one record in the same order and formatting the firmware used for its text log, cell voltage and state of charge with %f.
+// A sample record only holds one sensor, its signal is printed as "sample_<distance>mm" instead of "sensor_<distance>mm".
+// A corrected record has no gain, integration time or IR, its 32 bit signals are printed as "corrected_<distance>mm".
+// Version 2 corrected records stored them in the sensor and IR fields, since version 3 sensors without a corrected signal
+// (not in validSensors) are left out
+static void printRecord( FILE *out, const logFileHeader_t *header, const uint8_t *data )
+{
+  const uint8_t *distance = header->sensorDistance;
+  uint16_t cellVoltage = getLE16(data + offsetof(logRecord_t, cellVoltage));
+  uint16_t stateOfCharge = getLE16(data + offsetof(logRecord_t, stateOfCharge));
+  const uint8_t *gainIntTime = data + offsetof(logRecord_t, gainIntTime);
+  // version 1 has no record type, the byte was reserved and 0
+  uint8_t recordType = (header->version >= 2) ? data[offsetof(logRecord_t, recordType)] : LOG_RECORD_FRAME;
+  bool sample = (recordType == LOG_RECORD_SAMPLE);
+  bool corrected = (recordType == LOG_RECORD_CORRECTED);
+  int first = 0;
+  int last = LOG_NUMBER_OF_SENSORS - 1;
+  if (sample)  {
+    first = data[offsetof(logRecord_t, sampleSensor)];
+    if (first >= LOG_NUMBER_OF_SENSORS)  first = 0;
+    last = first;
+  }
+
+  fprintf(out, "\"cell_voltage\" = %f;\n", cellVoltage / 1000.0);
+  if (!corrected)  {
+    for (int i = first; i <= last; i++)  {
+      fprintf(out, "\"gain_%dmm\" = %d;\n", distance[i], gainIntTime[i] >> LOG_GAIN_SHIFT);
+    }
+    for (int i = first; i <= last; i++)  {
+      fprintf(out, "\"intTime_%dmm\" = %d;\n", distance[i], gainIntTime[i] & LOG_INT_TIME_MASK);
+    }
+    for (int i = first; i <= last; i++)  {
+      fprintf(out, "\"ir_%dmm\" = %d;\n", distance[i], getLE16(data + offsetof(logRecord_t, ir) + 2 * i));
+    }
+  }
+  fprintf(out, "ledStatus: %d;\n", data[offsetof(logRecord_t, LEDpattern)]);
+  for (int i = first; i <= last; i++)  {
+    uint16_t signal = getLE16(data + offsetof(logRecord_t, sensor) + 2 * i);
+    if (corrected)  {
+      if ((header->version >= 3) && !(data[offsetof(logRecord_t, validSensors)] & (1 << i)))  continue;
+      uint32_t value = (header->version >= 3) ? getLE32(data + offsetof(logRecord_t, corrected) + 4 * i)
+                     : signal | ((uint32_t)getLE16(data + offsetof(logRecord_t, ir) + 2 * i) << 16);
+      fprintf(out, "\"corrected_%dmm\" = %lu;\n", distance[i], (unsigned long)value);
+    }
+    else  {
+      fprintf(out, "\"%s_%dmm\" = %d;\n", sample ? "sample" : "sensor", distance[i], signal);
+    }
+  }
+  // %f has 6 decimals, enough to get the 1/256 % steps back: round(value * 256)
+  fprintf(out, "\"state_of_charge\" = %f;\n", stateOfCharge / 256.0);
+  fprintf(out, "\"temp_skin\" = %d;\n", getLE16(data + offsetof(logRecord_t, tempSkin)));
+  fprintf(out, "\"temp_amb\" = %d;\n", getLE16(data + offsetof(logRecord_t, tempAmb)));
+  fprintf(out, "time = %d;\n\n", (int)(int32_t)getLE32(data + offsetof(logRecord_t, time)));
+}
+
+int main( int argc, char **argv )
+{
+  bool allRecords = (argc > 1) && (strcmp(argv[1], "-a") == 0);
+  if (allRecords)  {
+    argc--;
+    argv++;
+  }
+  if ((argc < 2) || (argc > 3))  {
+    fprintf(stderr, "usage: %s [-a] <log.bin> [<log.txt>]\n", argv[0]);
+    return 2;
+  }
+  FILE *in = fopen(argv[1], "rb");
+  if (!in)  {
+    perror(argv[1]);
+    return 1;
+  }
+  FILE *out = stdout;
+  if (argc == 3)  {
+    out = fopen(argv[2], "w");
+    if (!out)  {
+      perror(argv[2]);
+      fclose(in);
+      return 1;
+    }
+  }
+
+  logFileHeader_t header;
+  int result = 1;
+  if (readHeader(in, &header))  {
+    uint8_t data[MAX_RECORD_SIZE];
+    size_t length;
+    unsigned long records = 0;
+    unsigned long skipped = 0;
+    while ((length = fread(data, 1, header.recordSize, in)) == header.recordSize)  {
+      // version 1 has no record type, the byte was reserved and 0
+      bool frame = (header.version < 2) || (data[offsetof(logRecord_t, recordType)] == LOG_RECORD_FRAME);
+      if (frame || allRecords)  {
+        printRecord(out, &header, data);
+        records++;
+      }
+      else  {
+        skipped++;
+      }
+    }
+    // the device may have lost power in the middle of a write
+    if (length > 0)  {
+      fprintf(stderr, "incomplete last record dropped (%u of %u bytes)\n", (unsigned)length, header.recordSize);
+    }
+    fprintf(stderr, "%lu records", records);
+    if (skipped > 0)  fprintf(stderr, ", %lu sample and corrected records skipped (-a converts them)", skipped);
+    fprintf(stderr, "\n");
+    result = 0;
+  }
+
+  fclose(in);
+  if (out != stdout)  fclose(out);
+  return result;
+}
@@ -0,0 +1,137 @@
+/* AmbientFilter.h
+streaming ambient light (dark frame) subtraction across LED patterns
+
+The LED patterns are acquired one after the other, e.g. dark -> LED1 -> LED2 -> dark -> ...
+Every illuminated frame is held until the next dark frame arrives. The ambient light of each sensor is then
+interpolated linearly between the dark sample before and the dark sample after the illuminated sample, using the
+per-sensor sample times, and subtracted. This removes ambient light and its slow drift (a lock-in at the frame rate).
+Signals are expected to be gain-normalized (Sensor_TSL2591::getHDRSignal), all arithmetic is integer.
+Invalid samples (failed or absent sensor) are left out: a sensor only gets a corrected value if its illuminated sample
+and both dark samples are valid. A failed dark sample is skipped, the next illuminated frames are interpolated from
+the last valid one.
+*/
+
+#ifndef _AMBIENT_FILTER_H_
+#define _AMBIENT_FILTER_H_
+
+#include <Arduino.h>
+
+#define AMBIENT_MAX_INTERPOLATION_SPAN   0xFFFF   // dark frames further apart than this (ms) are not interpolated, the mean is used
+
+template <uint8_t NUM_SENSORS, uint8_t NUM_LED_PATTERNS>
+class AmbientFilter
+{
+  public:
+    AmbientFilter( uint8_t darkPattern )
+    {
+      _darkPattern = darkPattern;
+      reset();
+    }
+
+    // forget all frames, e.g. after the acquisition was interrupted
+    void reset( void )
+    {
+      _haveDark = false;
+      _darkValidSensors = 0;
+      _pendingPatterns = 0;
+      _correctedPatterns = 0;
+    }
+
+    // add the frame of one LED pattern: gain-normalized signal and sample time (ms) of every sensor,
+    // validSensors has bit n set if the sample of sensor n is valid (Sensor_TSL2591::getValidSensors).
+    // Returns true if this was a dark frame and corrected values for the illuminated frames before it are available.
+    boolean addFrame( uint8_t LEDpattern, const uint32_t *signal, const uint32_t *sampleTime, uint8_t validSensors )
+    {
+      if (LEDpattern >= NUM_LED_PATTERNS)  return false;
+
+      if (LEDpattern != _darkPattern)  {
+        for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)  {
+          _signal[LEDpattern][iSens] = signal[iSens];
+          _sampleTime[LEDpattern][iSens] = sampleTime[iSens];
+        }
+        _validSensors[LEDpattern] = validSensors;
+        if (_haveDark)  _pendingPatterns |= 1 << LEDpattern;    // nothing to interpolate from before the first dark frame
+        return false;
+      }
+
+      // dark frame: correct all illuminated frames since the previous dark frame
+      _correctedPatterns = _pendingPatterns;
+      _pendingPatterns = 0;
+      for (uint8_t iPattern = 0; iPattern < NUM_LED_PATTERNS; iPattern++)  {
+        if ((_correctedPatterns & (1 << iPattern)) == 0)  continue;
+        _validSensors[iPattern] &= _darkValidSensors & validSensors;
+        for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)  {
+          if ((_validSensors[iPattern] & (1 << iSens)) == 0)  {
+            _signal[iPattern][iSens] = 0;
+            continue;
+          }
+          uint32_t ambient = interpolate(iSens, _sampleTime[iPattern][iSens], signal[iSens], sampleTime[iSens]);
+          _signal[iPattern][iSens] = (_signal[iPattern][iSens] > ambient) ? _signal[iPattern][iSens] - ambient : 0;
+        }
+      }
+
+      // a failed dark sample does not replace the last valid one
+      for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)  {
+        if ((validSensors & (1 << iSens)) == 0)  continue;
+        _darkSignal[iSens] = signal[iSens];
+        _darkTime[iSens] = sampleTime[iSens];
+      }
+      _darkValidSensors |= validSensors;
+      _haveDark = true;
+      return _correctedPatterns != 0;
+    }
+
+    // true if the last dark frame produced a corrected frame of this LED pattern
+    boolean isCorrected( uint8_t LEDpattern )
+    {
+      return (LEDpattern < NUM_LED_PATTERNS) && ((_correctedPatterns & (1 << LEDpattern)) != 0);
+    }
+
+    // bit mask of the sensors with a corrected signal, valid if isCorrected(LEDpattern)
+    uint8_t getValidSensors( uint8_t LEDpattern )
+    {
+      return _validSensors[LEDpattern];
+    }
+
+    // ambient corrected signal of a sensor, valid if isCorrected(LEDpattern) and the sensor's bit in getValidSensors() is set. 0 otherwise
+    uint32_t getCorrectedSignal( uint8_t LEDpattern, uint8_t sensorSelect )
+    {
+      return _signal[LEDpattern][sensorSelect];
+    }
+
+    // sample time of the illuminated sample a corrected signal was derived from (ms)
+    uint32_t getSampleTime( uint8_t LEDpattern, uint8_t sensorSelect )
+    {
+      return _sampleTime[LEDpattern][sensorSelect];
+    }
+
+  private:
+    // ambient signal of a sensor at time t, between the previous dark sample and the new one
+    uint32_t interpolate( uint8_t sensorSelect, uint32_t t, uint32_t darkSignal, uint32_t darkTime )
+    {
+      uint32_t prevSignal = _darkSignal[sensorSelect];
+      uint32_t span = darkTime - _darkTime[sensorSelect];
+      uint32_t dt = t - _darkTime[sensorSelect];
+
+      if ((span == 0) || (span > AMBIENT_MAX_INTERPOLATION_SPAN))  {
+        return (uint32_t) (((uint64_t) prevSignal + darkSignal) >> 1);
+      }
+      if (dt > span)  dt = span;     // the illuminated sample can't be newer than the dark one, but don't extrapolate
+      uint32_t frac = (dt << 16) / span;                                          // Q16 position between the dark samples
+      int64_t delta = (int64_t) darkSignal - (int64_t) prevSignal;
+      return (uint32_t) ((int64_t) prevSignal + ((delta * (int64_t) frac) >> 16));
+    }
+
+    uint8_t   _darkPattern;
+    boolean   _haveDark;
+    uint8_t   _pendingPatterns;       // bit mask of illuminated frames waiting for the next dark frame
+    uint8_t   _correctedPatterns;     // bit mask of frames corrected by the last dark frame
+    uint8_t   _darkValidSensors;      // bit mask of sensors that have a valid dark sample
+    uint8_t   _validSensors[NUM_LED_PATTERNS];      // bit mask of valid samples, after the correction of valid corrected signals
+    uint32_t  _darkSignal[NUM_SENSORS];
+    uint32_t  _darkTime[NUM_SENSORS];
+    uint32_t  _signal[NUM_LED_PATTERNS][NUM_SENSORS];       // raw until corrected, then ambient corrected
+    uint32_t  _sampleTime[NUM_LED_PATTERNS][NUM_SENSORS];
+};
+
+#endif
@@ -0,0 +1,52 @@
+/* BatteryMonitor.cpp
+low battery handling with the MAX17043 alert, steps the device down before a brownout
+*/
+
+#include "BatteryMonitor.h"
+#include "Log.h"
+
+BatteryMonitor::BatteryMonitor( FuelGauge *fuelGauge )
+{
+  _fuelGauge = fuelGauge;
+  _state = BATTERY_OK;
+}
+
+// the fuel gauge raises its alert flag when the state of charge drops below the threshold,
+// it is checked with every fuel gauge refresh, no extra I2C transaction
+void BatteryMonitor::begin( void )
+{
+  _fuelGauge->setAlertThreshold(BATTERY_LOW_SOC);
+  _fuelGauge->clearAlert();
+  _state = BATTERY_OK;
+}
+
+boolean BatteryMonitor::update( uint32_t now )
+{
+  if (!_fuelGauge->update(now))  return false;
+  uint8_t state = nextState();
+  if (state == _state)  return false;
+  LOG_INFO("battery state "); LOG_INFO(state); LOG_INFO(", mV "); LOG_INFOLN(_fuelGauge->getVCellMillivolts());
+  // the alert stays set until it is cleared, clear it once the battery has recovered so it can fire again
+  if (state == BATTERY_OK)  _fuelGauge->clearAlert();
+  _state = state;
+  return true;
+}
+
+uint8_t BatteryMonitor::getState( void )
+{
+  return _state;
+}
+
+// leaving a state needs some hysteresis, the cell voltage sags under load
+uint8_t BatteryMonitor::nextState( void )
+{
+  uint16_t cellVoltage = _fuelGauge->getVCellMillivolts();
+  uint16_t criticalVoltage = BATTERY_CRITICAL_MILLIVOLTS;
+  if (_state == BATTERY_CRITICAL)  criticalVoltage += BATTERY_CRITICAL_HYSTERESIS;
+  if (cellVoltage < criticalVoltage)  return BATTERY_CRITICAL;
+
+  if (_state == BATTERY_OK)  return _fuelGauge->isAlertSet() ? BATTERY_LOW : BATTERY_OK;
+  // the alert stays set until update() clears it, the state of charge decides when the battery has recovered
+  if (_fuelGauge->getSoCFixed() < ((BATTERY_LOW_SOC + BATTERY_LOW_HYSTERESIS) << 8))  return BATTERY_LOW;
+  return BATTERY_OK;
+}
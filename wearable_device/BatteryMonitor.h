@@ -0,0 +1,40 @@
+/* BatteryMonitor.h
+low battery handling with the MAX17043 alert, steps the device down before a brownout
+*/
+
+#ifndef _BATTERY_MONITOR_H_
+#define _BATTERY_MONITOR_H_
+
+#include <Arduino.h>
+#include "FuelGauge.h"
+
+#define BATTERY_LOW_SOC                 15      // % fuel gauge alert threshold, below it the device runs at the minimal rate and only logs
+#define BATTERY_LOW_HYSTERESIS          2       // % the state of charge has to recover before leaving the low battery state
+#define BATTERY_CRITICAL_MILLIVOLTS     3500    // below it SD logging stops, so no write is cut off by a brownout
+#define BATTERY_CRITICAL_HYSTERESIS     100     // mV the cell voltage has to recover before leaving the critical state
+
+typedef enum
+{
+  BATTERY_OK          = 0,
+  BATTERY_LOW         = 1,      // reduced rate, logging only
+  BATTERY_CRITICAL    = 2,      // no more SD writes
+}
+batteryState_t;
+
+class BatteryMonitor
+{
+  public:
+    BatteryMonitor( FuelGauge *fuelGauge );
+
+    void      begin( void );                // program the alert threshold, call after the fuel gauge was reset
+    boolean   update( uint32_t now );       // read the fuel gauge when due, returns true if the state changed
+    uint8_t   getState( void );
+
+  private:
+    uint8_t   nextState( void );
+
+    FuelGauge *_fuelGauge;
+    uint8_t   _state;
+};
+
+#endif
@@ -0,0 +1,55 @@
+/* Clock.cpp
+time source and low-power wait used by the acquisition loop
+*/
+
+#include "Clock.h"
+
+Clock SystemClock;
+
+Clock::Clock(void)
+{
+  _cycleStartTime = 0;
+  _sleepTime = 0;
+  _lastCycleActiveTime = 0;
+  _lastCycleSleepTime = 0;
+}
+
+uint32_t Clock::now( void )
+{
+  return millis();
+}
+
+// wait in the low-power mode and account the time actually slept
+void Clock::sleep( uint32_t ms )
+{
+  if (ms == 0)  return;
+  uint32_t start = now();
+  lowPowerWait(ms);
+  _sleepTime += now() - start;
+}
+
+// the CPU stops until the time is over or an enabled wake event occurs
+void Clock::lowPowerWait( uint32_t ms )
+{
+  RFduino_ULPDelay(ms);
+}
+
+void Clock::startCycle( void )
+{
+  uint32_t t = now();
+  uint32_t cycleTime = t - _cycleStartTime;
+  _lastCycleSleepTime = _sleepTime;
+  _lastCycleActiveTime = (cycleTime > _sleepTime) ? cycleTime - _sleepTime : 0;
+  _cycleStartTime = t;
+  _sleepTime = 0;
+}
+
+uint32_t Clock::getCycleActiveTime( void )
+{
+  return _lastCycleActiveTime;
+}
+
+uint32_t Clock::getCycleSleepTime( void )
+{
+  return _lastCycleSleepTime;
+}
@@ -0,0 +1,34 @@
+/* Clock.h
+time source and low-power wait used by the acquisition loop
+Derive from Clock to run the acquisition against a simulated time base on a host.
+*/
+
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include <Arduino.h>
+
+class Clock
+{
+  public:
+    Clock();
+
+    virtual uint32_t  now( void );            // ms
+    void      sleep( uint32_t ms );           // low-power wait, may return early on a wake event (pin wake, BLE)
+    void      startCycle( void );             // close the current cycle, its active/sleep times become available
+    uint32_t  getCycleActiveTime( void );     // ms awake during the last completed cycle
+    uint32_t  getCycleSleepTime( void );      // ms in low-power wait during the last completed cycle
+
+  protected:
+    virtual void  lowPowerWait( uint32_t ms );
+
+  private:
+    uint32_t  _cycleStartTime;
+    uint32_t  _sleepTime;         // sleep time of the running cycle
+    uint32_t  _lastCycleActiveTime;
+    uint32_t  _lastCycleSleepTime;
+};
+
+extern Clock SystemClock;
+
+#endif
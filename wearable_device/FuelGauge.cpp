@@ -10,6 +10,12 @@ FuelGauge::FuelGauge(void)
 {
   // can't use wire here, since wire is not initialized yet
   _initialized = false;
+  _measurementValid = false;
+  _refreshInterval = FUEL_GAUGE_REFRESH_INTERVAL;
+  _lastUpdateTime = 0;
+  _vcell = 0;
+  _soc = 0;
+  _alert = false;
 }
 
 boolean FuelGauge::begin(void)
@@ -19,25 +25,52 @@ boolean FuelGauge::begin(void)
   return _initialized;
 }
 
+// read VCELL, SOC and CONFIG in one burst, at most once per refresh interval
+boolean FuelGauge::update(uint32_t now) {
+
+	if (_measurementValid && (now - _lastUpdateTime < _refreshInterval))
+		return false;
+
+	byte data[MEASUREMENT_BURST_LENGTH];
+	if (!I2C.read(I2C_DEVICE_FUEL_GAUGE, MAX17043_ADDRESS, VCELL_REGISTER, data, MEASUREMENT_BURST_LENGTH))
+		return false;		// keep the last values, retry with the next call
+	_vcell = (data[0] << 8) | data[1];
+	_soc = (data[2] << 8) | data[3];
+	byte configMSB = data[CONFIG_REGISTER - VCELL_REGISTER];
+	byte configLSB = data[CONFIG_REGISTER - VCELL_REGISTER + 1];
+	_regCache.store(CONFIG_CACHE_MSB, configMSB);
+	_regCache.store(CONFIG_CACHE_LSB, configLSB);
+	_alert = (configLSB & CONFIG_ALERT_BIT) != 0;
+	_lastUpdateTime = now;
+	_measurementValid = true;
+	return true;
+}
+
+void FuelGauge::setRefreshInterval(uint16_t interval) {
+
+	_refreshInterval = interval;
+}
+
+// cell voltage in mV, 12 bit value with 1.25 mV per LSB
+uint16_t FuelGauge::getVCellMillivolts() {
+
+	return ((_vcell >> 4) * 5) >> 2;
+}
+
+// the SOC register already is fixed point: % in the MSB, 1/256 % in the LSB
+uint16_t FuelGauge::getSoCFixed() {
+
+	return _soc;
+}
+
 float FuelGauge::getVCell() {
 
-	byte MSB = 0;
-	byte LSB = 0;
-	
-	readRegister(VCELL_REGISTER, MSB, LSB);
-	int value = (MSB << 4) | (LSB >> 4);
-	return map(value, 0x000, 0xFFF, 0, 50000) / 10000.0;
-	//return value * 0.00125;
+	return getVCellMillivolts() / 1000.0;
 }
 
 float FuelGauge::getSoC() {
 	
-	byte MSB = 0;
-	byte LSB = 0;
-	
-	readRegister(SOC_REGISTER, MSB, LSB);
-	float decimal = LSB / 256.0;
-	return MSB + decimal;	
+	return getSoCFixed() / 256.0;
 }
 
 int FuelGauge::getVersion() {
@@ -64,7 +97,7 @@ byte FuelGauge::getAlertThreshold() {
 	byte LSB = 0;
 	
 	readConfigRegister(MSB, LSB);	
-	return 32 - (LSB & 0x1F);
+	return 32 - (LSB & CONFIG_THRESHOLD_MASK);
 }
 
 void FuelGauge::setAlertThreshold(byte threshold) {
@@ -74,9 +107,11 @@ void FuelGauge::setAlertThreshold(byte threshold) {
 	
 	readConfigRegister(MSB, LSB);	
 	if(threshold > 32) threshold = 32;
+	if(threshold < 1) threshold = 1;		// 32 would overflow into the alert flag
 	threshold = 32 - threshold;
 	
-	writeRegister(CONFIG_REGISTER, MSB, (LSB & 0xE0) | threshold);
+	// never write a cached alert flag back
+	writeRegister(CONFIG_REGISTER, MSB, (LSB & ~(CONFIG_ALERT_BIT | CONFIG_THRESHOLD_MASK)) | threshold);
 }
 
 boolean FuelGauge::inAlert() {
@@ -84,51 +119,97 @@ boolean FuelGauge::inAlert() {
 	byte MSB = 0;
 	byte LSB = 0;
 	
-	readConfigRegister(MSB, LSB);	
-	return LSB & 0x20;
+	// the alert bit is set by the fuel gauge, always read it from the device
+	if (!readRegister(CONFIG_REGISTER, MSB, LSB))
+		return false;
+	_regCache.store(CONFIG_CACHE_MSB, MSB);
+	_regCache.store(CONFIG_CACHE_LSB, LSB);
+	_alert = (LSB & CONFIG_ALERT_BIT) != 0;
+	return _alert;
 }
 
+boolean FuelGauge::isAlertSet() {
+
+	return _alert;
+}
+
+// the alert flag stays set until it is written to 0
 void FuelGauge::clearAlert() {
 
 	byte MSB = 0;
 	byte LSB = 0;
 	
-	readConfigRegister(MSB, LSB);	
+	// the cached copy may predate the alert, the write must not be skipped
+	if (!readRegister(CONFIG_REGISTER, MSB, LSB))
+		return;
+	_regCache.store(CONFIG_CACHE_MSB, MSB);
+	_regCache.store(CONFIG_CACHE_LSB, LSB);
+	writeRegister(CONFIG_REGISTER, MSB, LSB & ~CONFIG_ALERT_BIT);
+	_alert = false;
 }
 
 void FuelGauge::reset() {
 	
 	writeRegister(COMMAND_REGISTER, 0x00, 0x54);
+	invalidateRegisterCache();
 }
 
 void FuelGauge::quickStart() {
 	
 	writeRegister(MODE_REGISTER, 0x40, 0x00);
+	_measurementValid = false;		// the next update() reads the restarted estimate
 }
 
 
+// forget the cached configuration and measurement, call after the fuel gauge was reset or power cycled
+void FuelGauge::invalidateRegisterCache() {
+
+	_regCache.invalidateAll();
+	_measurementValid = false;
+}
+
+// read the configuration register, only the first read goes to the device
 void FuelGauge::readConfigRegister(byte &MSB, byte &LSB) {
 
-	readRegister(CONFIG_REGISTER, MSB, LSB);
+	if (_regCache.isValid(CONFIG_CACHE_MSB) && _regCache.isValid(CONFIG_CACHE_LSB)) {
+		MSB = _regCache.get(CONFIG_CACHE_MSB);
+		LSB = _regCache.get(CONFIG_CACHE_LSB);
+		return;
+	}
+	if (!readRegister(CONFIG_REGISTER, MSB, LSB))
+		return;
+	_regCache.store(CONFIG_CACHE_MSB, MSB);
+	_regCache.store(CONFIG_CACHE_LSB, LSB);
 }
 
-void FuelGauge::readRegister(byte startAddress, byte &MSB, byte &LSB) {
+// read a 16 bit register, MSB and LSB are left unchanged if the read failed
+boolean FuelGauge::readRegister(byte startAddress, byte &MSB, byte &LSB) {
 
-	Wire.beginTransmission(MAX17043_ADDRESS);
-	Wire.write(startAddress);
-	Wire.endTransmission();
-	
-	Wire.requestFrom(MAX17043_ADDRESS, 2);
-	MSB = Wire.read();
-	LSB = Wire.read();
+	byte data[2];
+	if (!I2C.read(I2C_DEVICE_FUEL_GAUGE, MAX17043_ADDRESS, startAddress, data, 2))
+		return false;
+	MSB = data[0];
+	LSB = data[1];
+	return true;
 }
 
 void FuelGauge::writeRegister(byte address, byte MSB, byte LSB) {
 
-	Wire.beginTransmission(MAX17043_ADDRESS);
-	Wire.write(address);
-	Wire.write(MSB);
-	Wire.write(LSB);
-	Wire.endTransmission();
+	// skip configuration writes that would not change anything
+	boolean isConfig = (address == CONFIG_REGISTER);
+	if (isConfig && _regCache.isCached(CONFIG_CACHE_MSB, MSB) && _regCache.isCached(CONFIG_CACHE_LSB, LSB))
+		return;
+
+	byte data[3] = {address, MSB, LSB};
+	if (!I2C.write(I2C_DEVICE_FUEL_GAUGE, MAX17043_ADDRESS, data, 3)) {
+		if (isConfig)
+			invalidateRegisterCache();
+		return;
+	}
+
+	if (isConfig) {
+		_regCache.store(CONFIG_CACHE_MSB, MSB);
+		_regCache.store(CONFIG_CACHE_LSB, LSB);
+	}
 }
 
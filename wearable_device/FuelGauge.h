@@ -8,6 +8,8 @@ modified from Luca Dentella's code (http://www.lucadentella.it)
 #define FUEL_GAUGE_H_
 
 #include <Wire.h>
+#include "I2CDevices.h"
+#include <RegisterCache.h>
 
 #define MAX17043_ADDRESS	0x36
 
@@ -18,12 +20,30 @@ modified from Luca Dentella's code (http://www.lucadentella.it)
 #define CONFIG_REGISTER		0x0C
 #define COMMAND_REGISTER	0xFE
 
+// CONFIG register LSB
+#define CONFIG_ALERT_BIT	0x20
+#define CONFIG_THRESHOLD_MASK	0x1F
+
+// VCELL and SOC are read together, the fuel gauge updates them only every few hundred ms.
+// The same burst reads on to the CONFIG register for the alert flag.
+#define MEASUREMENT_BURST_LENGTH	(CONFIG_REGISTER + 2 - VCELL_REGISTER)
+#define FUEL_GAUGE_REFRESH_INTERVAL	1000	// ms, default minimum time between two reads
+
+// register cache entries
+#define CONFIG_CACHE_MSB	0
+#define CONFIG_CACHE_LSB	1
+
 class FuelGauge
 {
   public:
     FuelGauge();
     boolean   begin ( void );
 
+    boolean update( uint32_t now );		// read VCELL, SOC and the alert flag if the refresh interval is over, true if new values were read
+    void setRefreshInterval( uint16_t interval );
+
+    uint16_t getVCellMillivolts();		// values of the last update()
+    uint16_t getSoCFixed();			// state of charge in 1/256 %
     float getVCell();
     float getSoC();
     int getVersion();
@@ -31,16 +51,25 @@ class FuelGauge
     byte getAlertThreshold();
     void setAlertThreshold(byte threshold);
     boolean inAlert();
+    boolean isAlertSet();		// alert flag of the last update()
     void clearAlert();
 
     void reset();
     void quickStart();
+    void invalidateRegisterCache();
 
   private:
     void readConfigRegister(byte &MSB, byte &LSB);
-    void readRegister(byte startAddress, byte &MSB, byte &LSB);
+    boolean readRegister(byte startAddress, byte &MSB, byte &LSB);
     void writeRegister(byte address, byte MSB, byte LSB);
     boolean _initialized;
+    boolean _measurementValid;
+    uint16_t _refreshInterval;
+    uint32_t _lastUpdateTime;
+    uint16_t _vcell;		// raw VCELL register, 12 bit value in the upper bits
+    uint16_t _soc;			// raw SOC register, % in the MSB, 1/256 % in the LSB
+    boolean _alert;
+    RegisterCache<2> _regCache;		// configuration register
 };
 
 #endif
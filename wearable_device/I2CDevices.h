@@ -0,0 +1,22 @@
+/* I2CDevices.h
+devices on the I2C bus of the wearable PCB, each one has its own error counter in I2CBus
+*/
+
+#ifndef _I2C_DEVICES_H_
+#define _I2C_DEVICES_H_
+
+#include <I2CBus.h>
+
+typedef enum
+{
+  I2C_DEVICE_MUX              = 0,    // PCA9548 multiplexer
+  I2C_DEVICE_LIGHT_SENSOR     = 1,    // TSL2591 sensors behind the multiplexer
+  I2C_DEVICE_LED_DRIVER       = 2,    // MAX6956
+  I2C_DEVICE_FUEL_GAUGE       = 3,    // MAX17043
+  I2C_NUMBER_OF_DEVICES       = 4,
+}
+i2cDevice_t;
+
+typedef char  i2cDeviceCountCheck_t[(I2C_NUMBER_OF_DEVICES <= I2C_MAX_DEVICES) ? 1 : -1];
+
+#endif
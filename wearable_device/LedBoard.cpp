@@ -0,0 +1,14 @@
+/* LedBoard.cpp
+LED patterns of the wearable PCB
+*/
+
+#include "LedBoard.h"
+
+// LED patterns in the order toggleLEDs_and_dark() applies them, a new pattern is just another line here.
+// Every pattern is written as one multi-port register image, the current registers only when the level changes.
+const ledPattern_t WearableLedBoard::patterns[NUM_LED_PATTERNS] = {
+  // LEDs on,       current, settle time
+  { (1 << LED2),    0x0,     0 },     // LED_PATTERN_LED2, 855 nm
+  { 0,              0x0,     0 },     // LED_PATTERN_DARK, ambient light only
+  { (1 << LED1),    0xF,     0 },     // LED_PATTERN_LED1, 650 nm
+};
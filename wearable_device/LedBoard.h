@@ -0,0 +1,59 @@
+/* LedBoard.h
+LEDs, RGB status LED and inputs of the wearable PCB on the MAX6956 LED driver
+*/
+
+#ifndef _LED_BOARD_H_
+#define _LED_BOARD_H_
+
+#include <Led_MAX6956.h>
+#include <LedAnimator.h>
+#include "I2CDevices.h"
+
+#define NUMBER_OF_LEDS 2
+#define NUMBER_OF_LED_PATTERNS            3       // Number of LED illumination patterns: e.g. all 680 nm LEDs, one 810 nm LED and dark measurement
+#define LED_PATTERN_LED2                  0       // LED2 on, toggleLEDs_and_dark() cycles through the pattern table in index order: dark -> LED1 -> LED2
+#define LED_PATTERN_DARK                  1       // all LEDs off, ambient light only
+#define LED_PATTERN_LED1                  2       // LED1 on
+
+#define LED1_NAME  "650nm"
+#define LED2_NAME  "855nm"
+
+typedef enum {
+  LED1  = 0,
+  LED2  = 1,
+  LAST_LED = LED2,
+} Portnum_t;
+
+class WearableLedBoard
+{
+  public:
+    enum
+    {
+      NUM_LEDS            = NUMBER_OF_LEDS,
+      NUM_LED_PATTERNS    = NUMBER_OF_LED_PATTERNS,
+      FIRST_LED_PORT      = 12,     // LED1 = ports 12 + 13, LED2 = ports 14 + 15
+      PORTS_PER_LED       = 2,
+      RED_LED_PORT        = 18,
+      GREEN_LED_PORT      = 19,
+      BLUE_LED_PORT       = 20,
+      BUTTON1_PORT        = 31,
+      BUTTON2_PORT        = 30,
+      BATTERY_STAT_PORT   = 29,
+    };
+
+    static const ledPattern_t  patterns[NUM_LED_PATTERNS];     // LedBoard.cpp
+
+    static boolean write( const uint8_t *data, uint8_t length )
+    {
+      return I2C.write(I2C_DEVICE_LED_DRIVER, MAX6956_ADDRESS, data, length);
+    }
+
+    static boolean read( uint8_t reg, uint8_t *value )
+    {
+      return I2C.read(I2C_DEVICE_LED_DRIVER, MAX6956_ADDRESS, reg, value, 1);
+    }
+};
+
+typedef Led_MAX6956<WearableLedBoard>  LedDriver;
+
+#endif
@@ -0,0 +1,44 @@
+/* Log.h
+compile-time log levels for the serial debug output
+Messages above LOG_LEVEL compile to nothing, their arguments are not evaluated.
+*/
+
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE    0
+#define LOG_LEVEL_ERROR   1       // hardware errors
+#define LOG_LEVEL_INFO    2       // startup and state changes
+#define LOG_LEVEL_DEBUG   3       // per sample output, blocks the main loop for a long time at 9600 baud
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL         LOG_LEVEL_ERROR
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(x)      Serial.print(x)
+#define LOG_ERRORLN(x)    Serial.println(x)
+#else
+#define LOG_ERROR(x)      do {} while (0)
+#define LOG_ERRORLN(x)    do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(x)       Serial.print(x)
+#define LOG_INFOLN(x)     Serial.println(x)
+#else
+#define LOG_INFO(x)       do {} while (0)
+#define LOG_INFOLN(x)     do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(x)      Serial.print(x)
+#define LOG_DEBUGLN(x)    Serial.println(x)
+#else
+#define LOG_DEBUG(x)      do {} while (0)
+#define LOG_DEBUGLN(x)    do {} while (0)
+#endif
+
+#endif
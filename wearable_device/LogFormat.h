@@ -0,0 +1,63 @@
+/* LogFormat.h
+binary SD log format, shared by the firmware and the host converter tools/sdlog2txt
+A log file is one logFileHeader_t followed by fixed size logRecord_t records, all little endian.
+Only standard C types here, the host tool includes this file as well.
+*/
+
+#ifndef _LOG_FORMAT_H_
+#define _LOG_FORMAT_H_
+
+#include <stdint.h>
+
+#define LOG_FORMAT_MAGIC            "SLOG"      // first 4 bytes of every log file
+#define LOG_FORMAT_MAGIC_LENGTH     4
+#define LOG_FORMAT_VERSION          3           // increment when logRecord_t changes, new fields only at the end or in reserved bytes
+#define LOG_FILE_EXTENSION          ".bin"
+
+#define LOG_NUMBER_OF_SENSORS       4
+#define LOG_GAIN_SHIFT              4           // gainIntTime: gain index in the high nibble
+#define LOG_INT_TIME_MASK           0x0F        // gainIntTime: integration time index in the low nibble
+
+// recordType, version 1 files only hold frames (the byte was reserved and 0)
+#define LOG_RECORD_FRAME            0           // all sensors of one LED pattern acquisition
+#define LOG_RECORD_SAMPLE           1           // one intermediate sample of sampleSensor, its other sensor fields are 0
+#define LOG_RECORD_CORRECTED        2           // ambient corrected frame of LEDpattern in corrected[], validSensors marks the sensors
+                                                // that have one. sensor, ir and gainIntTime are 0. Version 2 stored the signal
+                                                // as sensor[n] | ir[n] << 16 and had no corrected[]
+
+// file header, written when a new log file is created
+typedef struct
+{
+  char      magic[LOG_FORMAT_MAGIC_LENGTH];     // LOG_FORMAT_MAGIC, not terminated
+  uint8_t   version;                            // LOG_FORMAT_VERSION
+  uint8_t   headerSize;                         // bytes, the first record starts here
+  uint8_t   recordSize;                         // bytes per record, readers skip fields they do not know
+  uint8_t   numberOfSensors;
+  uint8_t   numberOfLedPatterns;
+  uint8_t   sensorDistance[LOG_NUMBER_OF_SENSORS];  // mm, sensor n is logged as "sensor_<distance>mm"
+  uint8_t   reserved[3];
+} logFileHeader_t;      // 16 bytes
+
+// one frame or sample, the fields of the info, detector and IR packets
+typedef struct
+{
+  uint32_t  time;                               // ms
+  uint16_t  cellVoltage;                        // mV
+  uint16_t  stateOfCharge;                      // 1/256 %
+  uint16_t  tempSkin;
+  uint16_t  tempAmb;
+  uint16_t  sensor[LOG_NUMBER_OF_SENSORS];      // full spectrum signal
+  uint16_t  ir[LOG_NUMBER_OF_SENSORS];          // IR signal
+  uint8_t   gainIntTime[LOG_NUMBER_OF_SENSORS]; // gain index << LOG_GAIN_SHIFT | integration time index
+  uint8_t   LEDpattern;
+  uint8_t   validSensors;                       // bit n set if sensor n was read out without I2C error
+  uint8_t   recordType;                         // LOG_RECORD_FRAME, _SAMPLE or _CORRECTED, since version 2
+  uint8_t   sampleSensor;                       // LOG_RECORD_SAMPLE: index of the sensor, since version 2
+  uint32_t  corrected[LOG_NUMBER_OF_SENSORS];   // LOG_RECORD_CORRECTED: signal gain-normalized to 9876x / 600 ms, since version 3
+} logRecord_t;          // 52 bytes
+
+// the layout must not depend on the compiler's padding
+typedef char  logFileHeaderSizeCheck_t[(sizeof(logFileHeader_t) == 16) ? 1 : -1];
+typedef char  logRecordSizeCheck_t[(sizeof(logRecord_t) == 52) ? 1 : -1];
+
+#endif
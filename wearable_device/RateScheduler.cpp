@@ -0,0 +1,111 @@
+/* RateScheduler.cpp
+picks the acquisition rate and LED pattern set from the workout, BLE connection and battery state
+*/
+
+#include "RateScheduler.h"
+
+#define RATE_ALL_PATTERNS   ((1 << NUMBER_OF_LED_PATTERNS) - 1)
+
+// default profiles, the cycle periods can be changed at runtime.
+// Every cycle starts with the dark pattern, the ambient correction needs it.
+const rateProfile_t RateDefaultProfiles[RATE_NUMBER_OF_PROFILES] = {
+  {     0, RATE_ALL_PATTERNS },                                     // RATE_PROFILE_FULL
+  {  5000, RATE_ALL_PATTERNS },                                     // RATE_PROFILE_DECIMATED
+  { 15000, (1 << LED_PATTERN_DARK) | (1 << LED_PATTERN_LED1) },     // RATE_PROFILE_MINIMAL, no LED2
+};
+
+// profile per state, indexed by RATE_STATE_WORKOUT | RATE_STATE_CONNECTED. A low battery always selects RATE_PROFILE_MINIMAL
+const uint8_t RateStateProfile[RATE_NUMBER_OF_STATES] = {
+  RATE_PROFILE_DECIMATED,     // idle
+  RATE_PROFILE_DECIMATED,     // workout, logging only
+  RATE_PROFILE_DECIMATED,     // idle, app connected
+  RATE_PROFILE_FULL,          // workout, streaming
+};
+
+RateScheduler::RateScheduler(void)
+{
+  for (uint8_t i = 0; i < RATE_NUMBER_OF_PROFILES; i++)  {
+    _profiles[i] = RateDefaultProfiles[i];
+  }
+  _state = 0;
+  _lowBattery = false;
+  _override = RATE_PROFILE_AUTO;
+  _cycleStarted = false;
+  _cycleStartTime = 0;
+  selectProfile();
+}
+
+void RateScheduler::setWorkout( boolean workout )
+{
+  if (workout)  _state |= RATE_STATE_WORKOUT;
+  else  _state &= ~RATE_STATE_WORKOUT;
+  selectProfile();
+}
+
+void RateScheduler::setConnected( boolean connected )
+{
+  if (connected)  _state |= RATE_STATE_CONNECTED;
+  else  _state &= ~RATE_STATE_CONNECTED;
+  selectProfile();
+}
+
+void RateScheduler::setLowBattery( boolean lowBattery )
+{
+  _lowBattery = lowBattery;
+  selectProfile();
+}
+
+// fix the profile regardless of the state, RATE_PROFILE_AUTO returns to the state table
+void RateScheduler::setProfileOverride( uint8_t profile )
+{
+  if ((profile >= RATE_NUMBER_OF_PROFILES) && (profile != RATE_PROFILE_AUTO))  return;
+  _override = profile;
+  selectProfile();
+}
+
+// change the cycle period of a profile, returns false for an illegal profile
+boolean RateScheduler::setCyclePeriod( uint8_t profile, uint16_t cyclePeriod )
+{
+  if (profile >= RATE_NUMBER_OF_PROFILES)  return false;
+  _profiles[profile].cyclePeriod = cyclePeriod;
+  return true;
+}
+
+uint8_t RateScheduler::getProfile( void )
+{
+  return _profile;
+}
+
+void RateScheduler::selectProfile( void )
+{
+  if (_override != RATE_PROFILE_AUTO)  _profile = _override;
+  else if (_lowBattery)  _profile = RATE_PROFILE_MINIMAL;
+  else  _profile = RateStateProfile[_state];
+}
+
+// the dark pattern is always acquired, it starts each cycle
+boolean RateScheduler::isPatternEnabled( uint8_t pattern )
+{
+  if (pattern == LED_PATTERN_DARK)  return true;
+  return (_profiles[_profile].patternMask & (1 << pattern)) != 0;
+}
+
+boolean RateScheduler::isCycleDue( uint32_t now )
+{
+  return getIdleTime(now) == 0;
+}
+
+void RateScheduler::startCycle( uint32_t now )
+{
+  _cycleStarted = true;
+  _cycleStartTime = now;
+}
+
+// the period of the current profile applies, so a switch to a faster profile takes effect right away
+uint32_t RateScheduler::getIdleTime( uint32_t now )
+{
+  if (!_cycleStarted)  return 0;
+  uint32_t elapsed = now - _cycleStartTime;
+  uint32_t period = _profiles[_profile].cyclePeriod;
+  return (elapsed < period) ? period - elapsed : 0;
+}
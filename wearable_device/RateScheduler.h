@@ -0,0 +1,63 @@
+/* RateScheduler.h
+picks the acquisition rate and LED pattern set from the workout, BLE connection and battery state
+*/
+
+#ifndef _RATE_SCHEDULER_H_
+#define _RATE_SCHEDULER_H_
+
+#include <Arduino.h>
+#include "LedBoard.h"
+
+#define RATE_PROFILE_AUTO            0xFF    // setProfileOverride(): pick the profile from the state table
+
+typedef enum
+{
+  RATE_PROFILE_FULL           = 0,    // LED pattern cycles back to back
+  RATE_PROFILE_DECIMATED      = 1,    // one cycle every few seconds
+  RATE_PROFILE_MINIMAL        = 2,    // keep the gain settled and the log going, nothing more
+  RATE_NUMBER_OF_PROFILES     = 3,
+}
+rateProfileIndex_t;
+
+typedef struct
+{
+  uint16_t  cyclePeriod;      // ms from the start of one LED pattern cycle to the start of the next, 0 = back to back
+  uint8_t   patternMask;      // bit n set: LED pattern n is acquired in each cycle
+}
+rateProfile_t;
+
+// state table index: bit 0 = workout running, bit 1 = BLE connected
+#define RATE_STATE_WORKOUT      0x01
+#define RATE_STATE_CONNECTED    0x02
+#define RATE_NUMBER_OF_STATES   4
+
+class RateScheduler
+{
+  public:
+    RateScheduler();
+
+    void      setWorkout( boolean workout );
+    void      setConnected( boolean connected );
+    void      setLowBattery( boolean lowBattery );       // selects RATE_PROFILE_MINIMAL, see BatteryMonitor
+    void      setProfileOverride( uint8_t profile );      // RATE_PROFILE_AUTO or a fixed rateProfileIndex_t
+    boolean   setCyclePeriod( uint8_t profile, uint16_t cyclePeriod );
+    uint8_t   getProfile( void );
+
+    boolean   isPatternEnabled( uint8_t pattern );
+    boolean   isCycleDue( uint32_t now );     // true once the next LED pattern cycle may start
+    void      startCycle( uint32_t now );
+    uint32_t  getIdleTime( uint32_t now );    // ms until the next cycle is due
+
+  private:
+    void      selectProfile( void );
+
+    rateProfile_t  _profiles[RATE_NUMBER_OF_PROFILES];
+    uint8_t   _state;
+    boolean   _lowBattery;
+    uint8_t   _override;
+    uint8_t   _profile;
+    boolean   _cycleStarted;
+    uint32_t  _cycleStartTime;
+};
+
+#endif
@@ -0,0 +1,81 @@
+/* RingBuffer.h
+fixed size history of the last SIZE values with a running sum
+used for the past signal values of the auto-gain, push() and sum() are O(1) independent of the history length
+*/
+
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+#include <Arduino.h>
+
+// T must be an unsigned integer type, SIZE * max(T) must fit into 32 bit
+template <typename T, uint8_t SIZE>
+class RingBuffer
+{
+  public:
+    RingBuffer()
+    {
+      clear();
+    }
+
+    // add a value, the oldest value drops out once the buffer is full
+    void push( T value )
+    {
+      if (_count == SIZE)  {
+        _sum -= _values[_head];
+      }
+      else  {
+        _count++;
+      }
+      _values[_head] = value;
+      _sum += value;
+      _head++;
+      if (_head >= SIZE)  _head = 0;
+    }
+
+    // value pushed age calls ago, 0 is the newest value. Only meaningful for age < count()
+    T get( uint8_t age )
+    {
+      int16_t pos = (int16_t) _head - 1 - age;
+      if (pos < 0)  pos += SIZE;
+      return _values[pos];
+    }
+
+    T newest( void )
+    {
+      return get(0);
+    }
+
+    // sum of the valid values
+    uint32_t sum( void )
+    {
+      return _sum;
+    }
+
+    // number of valid values
+    uint8_t count( void )
+    {
+      return _count;
+    }
+
+    boolean isFull( void )
+    {
+      return _count == SIZE;
+    }
+
+    // forget all values
+    void clear( void )
+    {
+      _head = 0;
+      _count = 0;
+      _sum = 0;
+    }
+
+  private:
+    T         _values[SIZE];
+    uint32_t  _sum;
+    uint8_t   _head;      // position of the next value
+    uint8_t   _count;
+};
+
+#endif
@@ -7,11 +7,19 @@ Stefan Kalchmair 04/2015
 #define _SENSOR_TSL2591_H_
 
 #include <Wire.h>
+#include "I2CDevices.h"
+#include "Clock.h"
+#include <RegisterCache.h>
+#include "RingBuffer.h"
+#include "Log.h"
+#include "Trace.h"
 
-#define NUMBER_OF_SENSORS               4       // Number of sensors on PCB
-#define MAXIMUM_NUMBER_OF_LED_PATTERNS  5       // Maximum number of LED illumination patterns: e.g. all 680 nm LEDs, one 810 nm LED and dark measurement
-#define NUMBER_OF_PAST_SIGNAL_VALUES    3      // Number of past signal values to average before making a gain/iTime switch decision
 #define AUTO_GAIN_SWITCH_BUFFER      5000     // when switching to a different gain/intTime, leave some space to make sure next value will be smaller than maximum
+#define INTEGRATION_TIME_STEP         100      // nominal integration time per integration time step (ms)
+#define INTEGRATION_TIME_WAIT_STEP    110      // wait time per integration time step (ms) before the ADC data is read out
+#define TSL2591_STATUS_POLL_INTERVAL  2      // ms between AVALID polls while an ADC may complete any moment
+#define TSL2591_OVERFLOW_100MS     0x9400      // ADC saturation count at 100 ms integration time
+#define TSL2591_OVERFLOW           0xFFFF      // ADC saturation count at 200 .. 600 ms integration time
 
 
 // I2C multiplexer
@@ -21,6 +29,11 @@ Stefan Kalchmair 04/2015
 #define MUX_SENSOR2          0x02
 #define MUX_SENSOR3          0x04
 #define MUX_SENSOR4          0x08
+#define MUX_SENSOR5          0x10
+#define MUX_SENSOR6          0x20
+#define MUX_SENSOR7          0x40
+#define MUX_SENSOR8          0x80
+#define MUX_CHANNELS         8        // maximum number of sensors behind the multiplexer
 
 #define PIN_WIRE_SDA         5
 #define PIN_WIRE_SCL         6
@@ -45,6 +58,8 @@ Stefan Kalchmair 04/2015
 
 #define TSL2591_CONTROL_RESET     0x80
 
+#define TSL2591_STATUS_AVALID     0x01    // ADC channels completed an integration cycle
+
 enum
 {
   TSL2591_REGISTER_ENABLE           = 0x00,
@@ -56,6 +71,7 @@ enum
   TSL2591_REGISTER_INTERRUPT        = 0x06,
   TSL2591_REGISTER_CRC              = 0x08,
   TSL2591_REGISTER_ID               = 0x0A,
+  TSL2591_REGISTER_DEVICE_STATUS    = 0x13,
   TSL2591_REGISTER_CHAN0_LOW        = 0x14,
   TSL2591_REGISTER_CHAN0_HIGH       = 0x15,
   TSL2591_REGISTER_CHAN1_LOW        = 0x16,
@@ -82,13 +98,106 @@ typedef enum
 }
 tsl2591Gain_t;
 
-const uint32_t GainIntegrationProduct[] = {1 * 100, 1 * 200, 1 * 300, 1 * 400, 1 * 500, 1 * 600, \
+// states of the non-blocking acquisition, advanced by poll()
+typedef enum
+{
+  TSL2591_ACQ_IDLE                  = 0,    // no acquisition started yet
+  TSL2591_ACQ_CONFIGURE             = 1,    // set gain/integration time of all sensors for the LED pattern
+  TSL2591_ACQ_ENABLE                = 2,    // power on all sensors, ADCs start integrating
+  TSL2591_ACQ_INTEGRATING           = 3,    // wait for the ADCs to complete
+  TSL2591_ACQ_READOUT               = 4,    // disable sensors and read channel 0 and channel 1
+  TSL2591_ACQ_DONE                  = 5,    // new signal values available
+}
+tsl2591AcqState_t;
+
+// how the acquisition decides that the ADCs have completed
+typedef enum
+{
+  TSL2591_WAIT_FIXED                = 0,    // wait the worst-case time of the longest integration time for all sensors
+  TSL2591_WAIT_STATUS               = 1,    // poll AVALID of each sensor, fall back to the worst-case time if it never reports
+}
+tsl2591WaitMode_t;
+
+// how the sensors are read out and re-armed within one acquisition
+typedef enum
+{
+  TSL2591_SCHEDULE_SYNCHRONOUS      = 0,    // every sensor delivers one sample per acquisition
+  TSL2591_SCHEDULE_STAGGERED        = 1,    // sensors with short integration times are re-armed until the slowest sensor is done, see isIntermediateSample()
+}
+tsl2591ScheduleMode_t;
+
+// how autoAdjustGain() picks the next gain/integration time
+typedef enum
+{
+  TSL2591_GAIN_STEPWISE             = 0,    // one iGI step at a time, decided on the average of the past signal values
+  TSL2591_GAIN_PREDICTIVE           = 1,    // jump to the highest iGI that will not overflow, decided on the last signal value
+}
+tsl2591GainMode_t;
+
+#define TSL2591_NUMBER_OF_GAINS              4    // low, medium, high, max
+#define TSL2591_NUMBER_OF_INTEGRATION_TIMES  6    // 100 ms .. 600 ms
+#define TSL2591_NUMBER_OF_iGI                24   // combined gain/integration time index iGI = gainIndex * 6 + integrationTimeIndex
+#define TSL2591_MAX_iGI                      23
+
+const uint32_t GainIntegrationProduct[TSL2591_NUMBER_OF_iGI] = {1 * 100, 1 * 200, 1 * 300, 1 * 400, 1 * 500, 1 * 600, \
                                            25 * 100, 25 * 200, 25 * 300, 25 * 400, 25 * 500, 25 * 600, \
                                            428 * 100, 428 * 200, 428 * 300, 428 * 400, 428 * 500, 428 * 600, \
                                            9876 * 100, 9876 * 200, 9876 * 300, 9876 * 400, 9876 * 500, 9876 * 600 \
                                           };
 
-class Sensor_TSL2591
+// lookup tables for the gain/integration time arithmetic, the Cortex-M0 has no divide instruction
+const uint8_t GainIntegrationIndex[TSL2591_NUMBER_OF_GAINS][TSL2591_NUMBER_OF_INTEGRATION_TIMES] = {{0, 1, 2, 3, 4, 5}, \
+                                           {6, 7, 8, 9, 10, 11}, \
+                                           {12, 13, 14, 15, 16, 17}, \
+                                           {18, 19, 20, 21, 22, 23} \
+                                          };
+const uint8_t iGI_GainIndex[TSL2591_NUMBER_OF_iGI] = {0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3};
+const uint8_t iGI_IntegrationTimeIndex[TSL2591_NUMBER_OF_iGI] = {0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5};
+const uint8_t GainRegisterValue[TSL2591_NUMBER_OF_GAINS] = {TSL2591_GAIN_LOW, TSL2591_GAIN_MED, TSL2591_GAIN_HIGH, TSL2591_GAIN_MAX};
+// HDR output: counts scaled to the most sensitive setting (9876x gain, 600 ms), so the signal stays continuous across gain switches.
+// Q16 factor GIP[iGI_max] / GIP[iGI] per iGI, evaluated by the compiler. 37888 counts at 1x/100 ms scale to 2.2e9, which fits 32 bit.
+#define TSL2591_HDR_SCALE(gain, time)   ((uint32_t) (65536.0 * 9876 * 600 / ((gain) * (time)) + 0.5))
+const uint32_t HDRScale[TSL2591_NUMBER_OF_iGI] = {TSL2591_HDR_SCALE(1, 100), TSL2591_HDR_SCALE(1, 200), TSL2591_HDR_SCALE(1, 300), \
+                                           TSL2591_HDR_SCALE(1, 400), TSL2591_HDR_SCALE(1, 500), TSL2591_HDR_SCALE(1, 600), \
+                                           TSL2591_HDR_SCALE(25, 100), TSL2591_HDR_SCALE(25, 200), TSL2591_HDR_SCALE(25, 300), \
+                                           TSL2591_HDR_SCALE(25, 400), TSL2591_HDR_SCALE(25, 500), TSL2591_HDR_SCALE(25, 600), \
+                                           TSL2591_HDR_SCALE(428, 100), TSL2591_HDR_SCALE(428, 200), TSL2591_HDR_SCALE(428, 300), \
+                                           TSL2591_HDR_SCALE(428, 400), TSL2591_HDR_SCALE(428, 500), TSL2591_HDR_SCALE(428, 600), \
+                                           TSL2591_HDR_SCALE(9876, 100), TSL2591_HDR_SCALE(9876, 200), TSL2591_HDR_SCALE(9876, 300), \
+                                           TSL2591_HDR_SCALE(9876, 400), TSL2591_HDR_SCALE(9876, 500), TSL2591_HDR_SCALE(9876, 600) \
+                                          };
+
+const uint8_t MuxSelectByte[MUX_CHANNELS] = {MUX_SENSOR1, MUX_SENSOR2, MUX_SENSOR3, MUX_SENSOR4, MUX_SENSOR5, MUX_SENSOR6, MUX_SENSOR7, MUX_SENSOR8};
+
+// I2C access to the sensors behind the multiplexer, independent of the size of the sensor array
+class Sensor_TSL2591_Bus
+{
+  public:
+    uint32_t  read32  ( uint8_t reg );
+    uint16_t  read16  ( uint8_t reg );
+    uint8_t   read8   ( uint8_t reg );
+    uint8_t   getSelectedSensor( void );
+
+  protected:
+    Sensor_TSL2591_Bus();
+
+    void      beginBus( void );           // release the multiplexer from reset and start I2C
+    boolean   selectChannel( uint8_t sensorSelect );
+    boolean   probeSensor( uint8_t sensorSelect );    // true if a TSL2591 answers on this multiplexer channel
+    boolean   writeRegister( uint8_t reg, uint8_t value );
+    boolean   writeMux( uint8_t muxSelectByte );
+
+    uint8_t                   selectedSensor;
+    boolean                   _initialized;
+    boolean                   _busError;        // set by any failed transaction, cleared by the caller
+    uint16_t                  _recoveryCount;   // I2C bus recoveries seen by the multiplexer cache
+    RegisterCache<1>          _muxCache;    // multiplexer channel select register
+};
+
+// Array of NUM_SENSORS photodetectors, each with its own gain/integration time per LED pattern.
+// NUM_PAST_SIGNAL_VALUES past signal values are averaged before making a gain/iTime switch decision.
+template <uint8_t NUM_SENSORS, uint8_t NUM_LED_PATTERNS, uint8_t NUM_PAST_SIGNAL_VALUES>
+class Sensor_TSL2591 : public Sensor_TSL2591_Bus
 {
   public:
     Sensor_TSL2591();
@@ -97,54 +206,98 @@ class Sensor_TSL2591
     void      enable  ( void );
     void      disable ( void );
     void      write8  ( uint8_t reg, uint8_t value );
-    uint32_t  read32  ( uint8_t reg );
-    uint16_t  read16  ( uint8_t reg );
-    uint8_t   read8   ( uint8_t reg );
 
     boolean  selectSensor( uint8_t sensorSelect );
     boolean  selectGain( uint8_t gainSelect );
     boolean  selectIntegrationTime( uint8_t integrationSelect );
-    uint8_t  getSelectedSensor( void );
     uint8_t  getCurrentLEDpattern( void );
     uint8_t  getGainIndex( uint8_t sensorSelect );
     uint8_t  getIntegrationTimeIndex( uint8_t sensorSelect );
 
-    uint8_t   scanForSensors ( void );  //return number of found sensors
+    uint8_t   scanForSensors ( void );  // return bit mask of the sensors that answered, bit 0 = sensor 0
+    uint8_t   getPresentSensors( void );  // bit mask found by the last scan, absent sensors are never accessed
+    boolean   isSensorPresent( uint8_t sensorSelect );
+    void      invalidateRegisterCache( void );  // call after a sensor or multiplexer reset
 
     boolean   autoAdjustGain( void );    // auto-adjust gain based on last measurements
-    void      startAcquisition( uint8_t LEDpattern );  // start the data acquisition for all detectors
+    boolean   autoAdjustGain( uint8_t LEDpattern );    // auto-adjust gain of one LED pattern, new settings apply at its next acquisition
+    void      startAcquisition( uint8_t LEDpattern );  // start the data acquisition for all detectors, blocks until all data is read
+    boolean   beginAcquisition( uint8_t LEDpattern, uint32_t now );  // start the data acquisition without blocking, advance with poll()
+    boolean   poll( uint32_t now );     // advance the acquisition state machine, returns true once when new signal values are available
+    boolean   isAcquisitionRunning( void );
+    uint32_t  getIdleTime( uint32_t now );    // ms until poll() has work again, the caller may sleep that long
+    void      setClock( Clock *clock );      // time base of the blocking startAcquisition(), SystemClock by default
+    tsl2591AcqState_t  getAcquisitionState( void );
+    void      setWaitMode( tsl2591WaitMode_t waitMode );
+    uint16_t  getStatusTimeoutCount( void );    // number of sensor readouts where AVALID never reported
+    void      setScheduleMode( tsl2591ScheduleMode_t scheduleMode );
+    void      setPipelinedMode( boolean pipelined );
+    void      setGainMode( tsl2591GainMode_t gainMode );
     uint16_t  getFullSpecSignal( uint8_t sensorSelect );  // return full spectrum signal for selected photodetector
     uint16_t  getIRSpecSignal( uint8_t sensorSelect );
+    boolean   isNewSampleAvailable( uint8_t sensorSelect );  // true until getFullSpecSignal is called for a new sample
+    boolean   isIntermediateSample( uint8_t sensorSelect );  // true if the last sample is not the frame sample of the acquisition
+    uint32_t  getSampleTime( uint8_t sensorSelect );   // time of the last readout (ms)
+    uint32_t  getHDRSignal( uint8_t sensorSelect, uint8_t channel );  // last sample of TSL2591_FULLSPECTRUM/INFRARED/VISIBLE, normalized to 9876x/600 ms
+    boolean   isGainSwitchSample( uint8_t sensorSelect );  // true if the last sample is the first one after a gain switch
+    boolean   isSampleValid( uint8_t sensorSelect );  // false if the last readout of the photodetector failed on the bus
+    uint8_t   getValidSensors( void );    // bit mask of photodetectors whose last sample is valid
+
+    // gain decision arithmetic, independent of the sensor state
+    boolean   isPredictedOverflow( uint32_t sum, uint8_t numValues, uint8_t iGI, uint8_t new_iGI );  // average of numValues values at iGI overflows at new_iGI
+    uint8_t   calcOptimal_iGI ( uint16_t sensorVal, uint8_t iGI );     // highest iGI a value taken at iGI does not overflow
 
   private:
-    tsl2591IntegrationTime_t  _integrationTime[NUMBER_OF_SENSORS] [MAXIMUM_NUMBER_OF_LED_PATTERNS];
-    tsl2591Gain_t             _gain[NUMBER_OF_SENSORS] [MAXIMUM_NUMBER_OF_LED_PATTERNS];
-    int32_t                   _sensorID[NUMBER_OF_SENSORS];
-    uint16_t                  _IRSpecSignal[NUMBER_OF_SENSORS];
-    uint16_t                  _fullSpecSignal[NUMBER_OF_SENSORS];
+    // the sensor bit masks are 8 bit wide and the multiplexer has 8 channels
+    typedef char              sensorCountCheck_t[(NUM_SENSORS > 0 && NUM_SENSORS <= MUX_CHANNELS) ? 1 : -1];
 
-    uint16_t                  _pastSigValue[NUMBER_OF_SENSORS] [MAXIMUM_NUMBER_OF_LED_PATTERNS] [NUMBER_OF_PAST_SIGNAL_VALUES];
-    uint8_t                   _recordedPastSigValues[NUMBER_OF_SENSORS] [MAXIMUM_NUMBER_OF_LED_PATTERNS];
+    uint16_t                  _IRSpecSignal[NUM_SENSORS];
+    uint16_t                  _fullSpecSignal[NUM_SENSORS];
+    uint32_t                  _sampleTime[NUM_SENSORS];
+    uint32_t                  _sensorStartTime[NUM_SENSORS];
+    uint8_t                   _newSampleSensors;    // bit mask of sensors with unread samples
+    uint8_t                   _sample_iGI[NUM_SENSORS];     // gain/integration time of the last sample
+    uint8_t                   _gainSwitchSensors;   // bit mask of sensors whose last sample follows a gain switch
+    uint8_t                   _intermediateSensors; // bit mask of sensors that were re-armed after their last readout
+    uint8_t                   _validSensors;        // bit mask of sensors whose last readout succeeded
+    uint8_t                   _patternValidSensors[NUM_LED_PATTERNS];  // _validSensors of the last readout of each LED pattern, for its auto-gain
+    uint8_t                   _presentSensors;      // bit mask of sensors found by scanForSensors()
+
+    RingBuffer<uint16_t, NUM_PAST_SIGNAL_VALUES>  _pastSigValues[NUM_SENSORS] [NUM_LED_PATTERNS];
 
-    uint8_t                   selectedSensor;
     uint8_t                   currentLEDpattern;
-    uint8_t                   gainIndex[NUMBER_OF_SENSORS] [MAXIMUM_NUMBER_OF_LED_PATTERNS];
-    uint8_t                   integrationTimeIndex[NUMBER_OF_SENSORS][MAXIMUM_NUMBER_OF_LED_PATTERNS];
+    uint8_t                   gainIndex[NUM_SENSORS] [NUM_LED_PATTERNS];
+    uint8_t                   integrationTimeIndex[NUM_SENSORS][NUM_LED_PATTERNS];
 
-    boolean                   _initialized;
+    RegisterCache<2 * NUM_SENSORS>  _regCache;    // ENABLE and CONTROL register of each sensor
 
-    void                      setGain( tsl2591Gain_t gain );
-    void                      setIntegrationTime( tsl2591IntegrationTime_t integrationTime );
-    tsl2591IntegrationTime_t  getIntegrationTime();
-    tsl2591Gain_t             getGain();
-    void                      gainIntTimeDown ( uint8_t sensorSelect );
-    void                      gainIntTimeUp ( uint8_t sensorSelect );
+    tsl2591AcqState_t         _acqState;
+    uint32_t                  _acqStartTime;    // time the sensors were enabled (ms)
+    uint32_t                  _acqWaitTime;     // time to wait for the ADCs to complete (ms)
+    uint8_t                   _acqPendingSensors;   // bit mask of sensors not read out yet
+    tsl2591WaitMode_t         _waitMode;
+    tsl2591ScheduleMode_t     _scheduleMode;
+    boolean                   _pipelined;
+    tsl2591GainMode_t         _gainMode;
+    Clock                    *_clock;
+    uint16_t                  _statusTimeoutCount;
+
+    void                      writeControl( void );
+    void                      gainIntTimeDown ( uint8_t sensorSelect, uint8_t LEDpattern );
+    void                      gainIntTimeUp ( uint8_t sensorSelect, uint8_t LEDpattern );
+    void                      traceGainSwitch ( uint8_t event, uint8_t sensorSelect, uint8_t LEDpattern, uint8_t old_iGI, uint16_t value );
     uint8_t                   calc_iGI ( uint8_t iGain, uint8_t iIntTime, int indexStep);
-    uint8_t                   calcNewGainIndex ( uint8_t iGI);
-    uint8_t                   calcNewIntegrationTimeIndex ( uint8_t iGI);
-    float                     SwitchUpMultiplier ( uint8_t sensorSelect );
-    uint8_t                   SwitchUpIntegrationTime ( uint8_t sensorSelect );
-    boolean                   isOverflow( float sensorVal, uint8_t intTimeIndex );
+    boolean                   predictGainIntTime ( uint8_t sensorSelect, uint8_t LEDpattern );
+    boolean                   isOverflow( uint32_t sensorVal, uint8_t intTimeIndex );
+    uint32_t                  getOverflowLimit( uint8_t intTimeIndex );
+    void                      configureSensors( void );
+    void                      enableSensors( uint32_t now );
+    void                      readoutSensors( uint32_t now );
+    void                      readoutSensor( uint8_t sensorSelect, uint32_t now, boolean intermediate );
+    void                      pollSensors( uint32_t now );
 };
 
+// template member definitions
+#include "Sensor_TSL2591_impl.h"
+
 #endif
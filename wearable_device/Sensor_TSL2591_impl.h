@@ -0,0 +1,760 @@
+/* Sensor_TSL2591_impl.h
+template member definitions of Sensor_TSL2591, included by Sensor_TSL2591.h
+Stefan Kalchmair 04/2015
+*/
+
+#ifndef _SENSOR_TSL2591_IMPL_H_
+#define _SENSOR_TSL2591_IMPL_H_
+
+#define TSL2591_TEMPLATE  template <uint8_t NUM_SENSORS, uint8_t NUM_LED_PATTERNS, uint8_t NUM_PAST_SIGNAL_VALUES>
+#define TSL2591_CLASS     Sensor_TSL2591<NUM_SENSORS, NUM_LED_PATTERNS, NUM_PAST_SIGNAL_VALUES>
+
+TSL2591_TEMPLATE
+TSL2591_CLASS::Sensor_TSL2591(void)
+{
+  // can't use wire here, since wire is not initialized yet
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)  {
+    for (uint8_t iLEDpattern = 0; iLEDpattern < NUM_LED_PATTERNS; iLEDpattern++)  {
+      gainIndex[iSens][iLEDpattern] = 0;
+      integrationTimeIndex[iSens][iLEDpattern] = 0;
+    }
+  }
+  currentLEDpattern = 0;
+  _acqState = TSL2591_ACQ_IDLE;
+  _acqStartTime = 0;
+  _acqWaitTime = 0;
+  _acqPendingSensors = 0;
+  _waitMode = TSL2591_WAIT_FIXED;
+  _scheduleMode = TSL2591_SCHEDULE_SYNCHRONOUS;
+  _pipelined = false;
+  _gainMode = TSL2591_GAIN_STEPWISE;
+  _clock = &SystemClock;
+  _statusTimeoutCount = 0;
+  _newSampleSensors = 0;
+  _gainSwitchSensors = 0;
+  _intermediateSensors = 0;
+  _validSensors = 0;
+  _presentSensors = 0;
+  for (uint8_t iLEDpattern = 0; iLEDpattern < NUM_LED_PATTERNS; iLEDpattern++)  {
+    _patternValidSensors[iLEDpattern] = 0;
+  }
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)  {
+    _sensorStartTime[iSens] = 0;
+    _sampleTime[iSens] = 0;
+    _sample_iGI[iSens] = 0;
+  }
+}
+
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::begin( void )
+{
+  beginBus();
+  invalidateRegisterCache();
+
+  _presentSensors = scanForSensors();
+  LOG_INFO("TSL2591 sensors found, bit mask "); LOG_INFOLN(_presentSensors);
+  if (_presentSensors == 0)  return false;
+
+  _initialized = true;
+
+  uint8_t initialGain = 3;              // high gain
+  uint8_t initialIntegrationTime = 0;   // 600ms integration time
+  // Set default integration time and gain for all sensors
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)  {
+    for (uint8_t iLEDpattern = 0; iLEDpattern < NUM_LED_PATTERNS; iLEDpattern++)  {
+      gainIndex[iSens][iLEDpattern] = initialGain;
+      integrationTimeIndex[iSens][iLEDpattern] = initialIntegrationTime;
+    }
+    if (!isSensorPresent(iSens))  continue;
+    selectSensor(iSens);
+    writeControl();
+  }
+  currentLEDpattern = 0;
+  // Leave device in power down mode on bootup
+  return true;
+}
+
+// switch I2C_MUX to the desired sensor
+TSL2591_TEMPLATE
+boolean  TSL2591_CLASS::selectSensor( uint8_t sensorSelect )
+{
+  if (sensorSelect >= NUM_SENSORS)  {
+    writeMux(0x00);  // no sensor selected
+    LOG_ERRORLN("Error: Illegal sensor number");
+    return false;
+  }
+  return selectChannel(sensorSelect);
+}
+
+// forget all cached register values, call after the sensors or the multiplexer were reset
+TSL2591_TEMPLATE
+void TSL2591_CLASS::invalidateRegisterCache( void )
+{
+  _muxCache.invalidateAll();
+  _regCache.invalidateAll();
+}
+
+// switch sensor to the desired gain value
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::selectGain (uint8_t gainselect)
+{
+  if (gainselect >= TSL2591_NUMBER_OF_GAINS)  {
+    LOG_ERRORLN("Gain select index out of bounds");
+    return true;
+  }
+  gainIndex[selectedSensor][currentLEDpattern] = gainselect;
+  writeControl();
+  return false;
+}
+
+// switch sensor to the desired integration time
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::selectIntegrationTime (uint8_t integrationSelect)
+{
+  if (integrationSelect >= TSL2591_NUMBER_OF_INTEGRATION_TIMES)  {
+    LOG_ERRORLN("Integration time select index out of bounds");
+    return true;
+  }
+  integrationTimeIndex[selectedSensor][currentLEDpattern] = integrationSelect;
+  writeControl();
+  return false;
+}
+
+// write gain and integration time of the current LED pattern to the selected sensor
+TSL2591_TEMPLATE
+void TSL2591_CLASS::writeControl( void )
+{
+  uint8_t control = GainRegisterValue[gainIndex[selectedSensor][currentLEDpattern]] | integrationTimeIndex[selectedSensor][currentLEDpattern];
+  write8(TSL2591_COMMAND_BIT | TSL2591_REGISTER_CONTROL, control);
+}
+
+// return current LED pattern
+TSL2591_TEMPLATE
+uint8_t  TSL2591_CLASS::getCurrentLEDpattern( void )
+{
+  return currentLEDpattern;
+}
+
+// return gain index
+TSL2591_TEMPLATE
+uint8_t  TSL2591_CLASS::getGainIndex( uint8_t sensorSelect )
+{
+  return gainIndex[sensorSelect][currentLEDpattern];
+}
+
+// return integration time index
+TSL2591_TEMPLATE
+uint8_t  TSL2591_CLASS::getIntegrationTimeIndex( uint8_t sensorSelect )
+{
+  return integrationTimeIndex[sensorSelect][currentLEDpattern];
+}
+
+TSL2591_TEMPLATE
+void TSL2591_CLASS::enable(void)
+{
+  if (!_initialized) {
+    LOG_ERRORLN("Error: Sensor not initialized");
+    return;
+  }
+  write8(TSL2591_COMMAND_BIT | TSL2591_REGISTER_ENABLE, TSL2591_ENABLE_POWERON | TSL2591_ENABLE_AEN | TSL2591_ENABLE_AIEN);     // Enable the device by setting the control bit to 0x01
+}
+
+TSL2591_TEMPLATE
+void TSL2591_CLASS::disable(void)
+{
+  if (!_initialized) {
+    LOG_ERRORLN("Error: Sensor not initialized");
+    return;
+  }
+  write8(TSL2591_COMMAND_BIT | TSL2591_REGISTER_ENABLE, TSL2591_ENABLE_POWEROFF);       // Disable the device by setting the control bit to 0x00
+}
+
+// write 8 bit from sensor, ENABLE and CONTROL writes are skipped if the register holds the value already
+TSL2591_TEMPLATE
+void TSL2591_CLASS::write8 (uint8_t reg, uint8_t value)
+{
+  int8_t cacheIndex = -1;
+  if ((reg & ~TSL2591_COMMAND_BIT) == TSL2591_REGISTER_ENABLE)   cacheIndex = selectedSensor * 2;
+  if ((reg & ~TSL2591_COMMAND_BIT) == TSL2591_REGISTER_CONTROL)  cacheIndex = selectedSensor * 2 + 1;
+  if ((cacheIndex >= 0) && _regCache.isCached(cacheIndex, value))  return;
+
+  boolean written = writeRegister(reg, value);
+  if (cacheIndex < 0)  return;
+  if (written)  _regCache.store(cacheIndex, value);
+  else  _regCache.invalidate(cacheIndex);     // the register content is unknown now
+}
+
+// start the data acquisition for all sensors, block until all sensors are read out.
+// The core sleeps in between the bus accesses.
+TSL2591_TEMPLATE
+void TSL2591_CLASS::startAcquisition( uint8_t LEDpattern )
+{
+  beginAcquisition(LEDpattern, _clock->now());
+  while (poll(_clock->now()) == false)  {
+    _clock->sleep(getIdleTime(_clock->now()));
+  }
+}
+
+// start the data acquisition for all sensors without blocking; the acquisition is advanced by poll()
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::beginAcquisition( uint8_t LEDpattern, uint32_t now )
+{
+  if (isAcquisitionRunning())  {
+    LOG_ERRORLN("Error: Acquisition already running");
+    return false;
+  }
+  if (LEDpattern >= NUM_LED_PATTERNS)  {
+    LOG_ERRORLN("Error: Illegal LED pattern");
+    return false;
+  }
+  LOG_DEBUGLN("--- Start data acquisition ---");
+  currentLEDpattern = LEDpattern;
+  _acqStartTime = now;
+  _acqState = TSL2591_ACQ_CONFIGURE;
+  if (_pipelined)  {            // configure and start the ADCs right away instead of on the next poll()
+    configureSensors();
+    enableSensors(now);
+    _acqState = TSL2591_ACQ_INTEGRATING;
+  }
+  return true;
+}
+
+// advance the acquisition by one step, returns true once when new signal values are available
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::poll( uint32_t now )
+{
+  switch (_acqState)
+  {
+    case TSL2591_ACQ_CONFIGURE :
+      configureSensors();
+      _acqState = TSL2591_ACQ_ENABLE;
+      break;
+    case TSL2591_ACQ_ENABLE :
+      enableSensors(now);
+      _acqStartTime = now;
+      _acqState = TSL2591_ACQ_INTEGRATING;
+      break;
+    case TSL2591_ACQ_INTEGRATING :
+      if ((_waitMode == TSL2591_WAIT_STATUS) || (_scheduleMode == TSL2591_SCHEDULE_STAGGERED))  {   // read out every sensor as soon as its ADC is done
+        pollSensors(now);
+      }
+      if ((_acqPendingSensors == 0) || ((uint32_t) (now - _acqStartTime) >= _acqWaitTime))  {     // wait x ms for ADC to complete
+        _acqState = TSL2591_ACQ_READOUT;
+      }
+      break;
+    case TSL2591_ACQ_READOUT :
+      readoutSensors(now);
+      _acqState = TSL2591_ACQ_DONE;
+      return true;
+    default:    // idle or done: nothing to do
+      break;
+  }
+  return false;
+}
+
+// return true while an acquisition is in progress
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::isAcquisitionRunning( void )
+{
+  return (_acqState != TSL2591_ACQ_IDLE) && (_acqState != TSL2591_ACQ_DONE);
+}
+
+TSL2591_TEMPLATE
+tsl2591AcqState_t TSL2591_CLASS::getAcquisitionState( void )
+{
+  return _acqState;
+}
+
+// time until the next sensor can have completed its integration, 0 if poll() has work right away.
+// Within the AVALID window of a sensor the status is polled every TSL2591_STATUS_POLL_INTERVAL ms.
+TSL2591_TEMPLATE
+uint32_t TSL2591_CLASS::getIdleTime( uint32_t now )
+{
+  if ((_acqState != TSL2591_ACQ_INTEGRATING) || (_acqPendingSensors == 0))  return 0;
+
+  uint32_t elapsed = now - _acqStartTime;
+  if (elapsed >= _acqWaitTime)  return 0;
+  uint32_t idleTime = _acqWaitTime - elapsed;     // worst case of the whole acquisition
+  if ((_waitMode != TSL2591_WAIT_STATUS) && (_scheduleMode != TSL2591_SCHEDULE_STAGGERED))  return idleTime;
+
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)
+  {
+    if ((_acqPendingSensors & (1 << iSens)) == 0)  continue;
+
+    uint32_t sensorElapsed = now - _sensorStartTime[iSens];
+    uint8_t iTime = integrationTimeIndex[iSens][currentLEDpattern];
+    uint32_t readyTime = (uint32_t) (iTime + 1) * ((_waitMode == TSL2591_WAIT_STATUS) ? INTEGRATION_TIME_STEP : INTEGRATION_TIME_WAIT_STEP);
+    uint32_t sensorIdleTime;
+    if (sensorElapsed < readyTime)  sensorIdleTime = readyTime - sensorElapsed;
+    else if (sensorElapsed < (uint32_t) (iTime + 1) * INTEGRATION_TIME_WAIT_STEP)  sensorIdleTime = TSL2591_STATUS_POLL_INTERVAL;
+    else  return 0;
+    if (sensorIdleTime < idleTime)  idleTime = sensorIdleTime;
+  }
+  return idleTime;
+}
+
+// time base of the blocking startAcquisition()
+TSL2591_TEMPLATE
+void TSL2591_CLASS::setClock( Clock *clock )
+{
+  _clock = clock;
+}
+
+// select how the end of the integration is detected
+TSL2591_TEMPLATE
+void TSL2591_CLASS::setWaitMode( tsl2591WaitMode_t waitMode )
+{
+  _waitMode = waitMode;
+}
+
+// return number of sensor readouts that had to fall back to the worst-case wait time
+TSL2591_TEMPLATE
+uint16_t TSL2591_CLASS::getStatusTimeoutCount( void )
+{
+  return _statusTimeoutCount;
+}
+
+// pipelined mode: beginAcquisition() configures and enables the sensors immediately, so the next
+// LED pattern integrates while the previous one is still being processed
+TSL2591_TEMPLATE
+void TSL2591_CLASS::setPipelinedMode( boolean pipelined )
+{
+  _pipelined = pipelined;
+}
+
+// select the stepwise or the predictive auto-gain
+TSL2591_TEMPLATE
+void TSL2591_CLASS::setGainMode( tsl2591GainMode_t gainMode )
+{
+  _gainMode = gainMode;
+}
+
+// select whether all sensors are read out together or fast sensors are re-armed independently
+TSL2591_TEMPLATE
+void TSL2591_CLASS::setScheduleMode( tsl2591ScheduleMode_t scheduleMode )
+{
+  _scheduleMode = scheduleMode;
+}
+
+// set gain/integration times of all sensors for the current LED pattern
+TSL2591_TEMPLATE
+void TSL2591_CLASS::configureSensors( void )
+{
+  uint8_t maxIntegrationTimeIndex = 0;
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)
+  {
+    if (!isSensorPresent(iSens))  continue;
+    selectSensor(iSens);
+    writeControl();
+
+    if (integrationTimeIndex[iSens][currentLEDpattern] > maxIntegrationTimeIndex)  {    // find maximum integration time
+      maxIntegrationTimeIndex = integrationTimeIndex[iSens][currentLEDpattern];
+    }
+    LOG_DEBUG("iSens= "); LOG_DEBUG(iSens); LOG_DEBUG(" currentLEDpattern= "); LOG_DEBUG(currentLEDpattern);  LOG_DEBUG("  gain/iTime = "); LOG_DEBUG(gainIndex[iSens][currentLEDpattern]); LOG_DEBUG(" / ");  LOG_DEBUGLN(integrationTimeIndex[iSens][currentLEDpattern]);
+  }
+  _acqWaitTime = (uint32_t) (maxIntegrationTimeIndex + 1) * INTEGRATION_TIME_WAIT_STEP;
+}
+
+// enable all sensors
+TSL2591_TEMPLATE
+void TSL2591_CLASS::enableSensors( uint32_t now )
+{
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)
+  {
+    if (!isSensorPresent(iSens))  continue;     // never pending, so it is not polled or read out either
+    selectSensor(iSens);
+    enable();
+    _sensorStartTime[iSens] = now;
+    _acqPendingSensors |= 1 << iSens;
+  }
+}
+
+// check all sensors that are not read out yet and read out the ones that completed
+TSL2591_TEMPLATE
+void TSL2591_CLASS::pollSensors( uint32_t now )
+{
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)
+  {
+    if ((_acqPendingSensors & (1 << iSens)) == 0)  continue;
+
+    uint32_t elapsedTime = now - _sensorStartTime[iSens];
+    uint8_t iTime = integrationTimeIndex[iSens][currentLEDpattern];
+    if (elapsedTime < (uint32_t) (iTime + 1) * INTEGRATION_TIME_STEP)  continue;     // ADC can't be done yet, don't waste bus time
+
+    // staggered mode: start the next integration right after the readout if it completes before the slowest sensor.
+    // Such a sample is an intermediate sample, the last one of the acquisition is the sensor's frame sample.
+    boolean rearm = (_scheduleMode == TSL2591_SCHEDULE_STAGGERED)
+                    && ((uint32_t) (now - _acqStartTime) + (uint32_t) (iTime + 1) * INTEGRATION_TIME_WAIT_STEP <= _acqWaitTime);
+
+    if (elapsedTime >= (uint32_t) (iTime + 1) * INTEGRATION_TIME_WAIT_STEP)  {       // worst-case time is over, read it anyway
+      if (_waitMode == TSL2591_WAIT_STATUS)  {
+        LOG_DEBUG("Sens"); LOG_DEBUG(iSens); LOG_DEBUGLN(": AVALID timeout");
+        Trace.record(TRACE_AVALID_TIMEOUT, iSens, currentLEDpattern, iTime, iTime, elapsedTime);
+        _statusTimeoutCount++;
+      }
+      readoutSensor(iSens, now, rearm);
+    }
+    else if (_waitMode == TSL2591_WAIT_STATUS)  {
+      selectSensor(iSens);
+      if (read8(TSL2591_REGISTER_DEVICE_STATUS) & TSL2591_STATUS_AVALID)  {
+        readoutSensor(iSens, now, rearm);
+      }
+    }
+
+    if (rearm && ((_acqPendingSensors & (1 << iSens)) == 0))  {
+      enable();       // sensor is still selected, gain and integration time are unchanged
+      _sensorStartTime[iSens] = now;
+      _acqPendingSensors |= 1 << iSens;
+    }
+  }
+}
+
+// disable oscillator, then read channel 0 and channel 1 of one sensor. Only frame samples go into the past signal
+// value buffer, so the auto-gain averages NUM_PAST_SIGNAL_VALUES frames whatever the number of intermediate samples
+TSL2591_TEMPLATE
+void TSL2591_CLASS::readoutSensor( uint8_t sensorSelect, uint32_t now, boolean intermediate )
+{
+  uint32_t sensorSignal_FS_IR;
+  // the previous readout of this sensor was an intermediate sample, so this is not the first one of the acquisition
+  boolean firstOfAcquisition = (_intermediateSensors & (1 << sensorSelect)) == 0;
+  if (intermediate)  _intermediateSensors |= 1 << sensorSelect;
+  else  _intermediateSensors &= ~(1 << sensorSelect);
+  _busError = false;
+  selectSensor(sensorSelect);
+  disable();
+  // read channel 0 and channel 1 simultaneously
+  sensorSignal_FS_IR = read32(TSL2591_COMMAND_BIT | TSL2591_REGISTER_CHAN0_LOW);
+  _fullSpecSignal[sensorSelect] = sensorSignal_FS_IR & 0xFFFF;
+  _IRSpecSignal[sensorSelect] = (sensorSignal_FS_IR >> 16) & 0xFFFF;
+  _sampleTime[sensorSelect] = now;
+  _acqPendingSensors &= ~(1 << sensorSelect);
+  _newSampleSensors |= 1 << sensorSelect;
+  _sample_iGI[sensorSelect] = GainIntegrationIndex[gainIndex[sensorSelect][currentLEDpattern]][integrationTimeIndex[sensorSelect][currentLEDpattern]];
+
+  // a failed readout is reported as invalid and kept out of the past signal buffer, so it can't trigger a gain switch.
+  // The registers of the sensor are rewritten at its next configuration.
+  if (_busError)  {
+    LOG_DEBUG("Sens"); LOG_DEBUG(sensorSelect); LOG_DEBUGLN(": readout failed");
+    _validSensors &= ~(1 << sensorSelect);
+    _patternValidSensors[currentLEDpattern] &= ~(1 << sensorSelect);
+    _regCache.invalidate(sensorSelect * 2);
+    _regCache.invalidate(sensorSelect * 2 + 1);
+    return;
+  }
+  _validSensors |= 1 << sensorSelect;
+  _patternValidSensors[currentLEDpattern] |= 1 << sensorSelect;
+
+  // the past signal buffer is cleared on every gain switch, so an empty buffer means this is the first frame at the new setting
+  if (firstOfAcquisition && (_pastSigValues[sensorSelect][currentLEDpattern].count() == 0))  _gainSwitchSensors |= 1 << sensorSelect;
+  else  _gainSwitchSensors &= ~(1 << sensorSelect);
+  if (!intermediate)  _pastSigValues[sensorSelect][currentLEDpattern].push(_fullSpecSignal[sensorSelect]);
+}
+
+// read out all remaining sensors
+TSL2591_TEMPLATE
+void TSL2591_CLASS::readoutSensors( uint32_t now )
+{
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)
+  {
+    if (_acqPendingSensors & (1 << iSens))  {
+      readoutSensor(iSens, now, false);
+    }
+  }
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+  // display past array
+  LOG_DEBUGLN("- past signal value buffer -");
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)  {
+    for (uint8_t iPastVal = 0; iPastVal < _pastSigValues[iSens][currentLEDpattern].count(); iPastVal++)    {
+      LOG_DEBUG(_pastSigValues[iSens][currentLEDpattern].get(iPastVal)); LOG_DEBUG(" / ");
+    }
+    LOG_DEBUG(" # valid signal values in buffer= "); LOG_DEBUG(_pastSigValues[iSens][currentLEDpattern].count());
+    LOG_DEBUGLN(" ");
+  }
+#endif
+}
+
+// auto-adjust gain based on last measurements
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::autoAdjustGain( void )
+{
+  return autoAdjustGain(currentLEDpattern);
+}
+
+// auto-adjust gain of an LED pattern based on its last measurements. The new gain/integration time is only
+// staged and gets written to the sensors when the pattern is acquired next, so this is safe to call while
+// the following LED pattern is integrating. Returns true if any sensor switched.
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::autoAdjustGain( uint8_t LEDpattern )
+{
+  boolean switched = false;
+  if (LEDpattern >= NUM_LED_PATTERNS)  return false;
+  LOG_DEBUGLN("--- auto-adjust gain/integrationTime ---");
+  for (uint8_t iSens = 0; iSens < NUM_SENSORS; iSens++)
+  {
+    // don't decide on a history that just missed a sample. The last readout of the sensor may belong to
+    // another LED pattern (pipelined or staggered acquisition), so check the last one of this pattern
+    if ((_patternValidSensors[LEDpattern] & (1 << iSens)) == 0)  continue;
+
+    // predictive mode: jump right away if the last signal value is far off, otherwise fall through to the stepwise switch
+    if ((_gainMode == TSL2591_GAIN_PREDICTIVE) && (_pastSigValues[iSens][LEDpattern].count() > 0))  {
+      if (predictGainIntTime(iSens, LEDpattern))  {
+        _pastSigValues[iSens][LEDpattern].clear();  // start filling the past signal buffer again
+        switched = true;
+        continue;
+      }
+    }
+
+    if (_pastSigValues[iSens][LEDpattern].isFull())
+    {
+      // the decisions compare the sum of the past signal values so no division is needed
+      uint32_t pastValSum = _pastSigValues[iSens][LEDpattern].sum();
+      LOG_DEBUG("pastValAvg(iSens="); LOG_DEBUG(iSens); LOG_DEBUG(" /LEDpatt= "); LOG_DEBUG(LEDpattern); LOG_DEBUG("): "); LOG_DEBUGLN(pastValSum / NUM_PAST_SIGNAL_VALUES);
+
+      uint8_t old_iGI = GainIntegrationIndex[gainIndex[iSens][LEDpattern]][integrationTimeIndex[iSens][LEDpattern]];
+      if (isPredictedOverflow(pastValSum, NUM_PAST_SIGNAL_VALUES, old_iGI, old_iGI) == true)  {          // if overflow then switch down. Check only full spectrum since this detector is more sensitive
+        gainIntTimeDown(iSens, LEDpattern);        // turn down gain or integration time
+        traceGainSwitch(TRACE_GAIN_DOWN, iSens, LEDpattern, old_iGI, pastValSum / NUM_PAST_SIGNAL_VALUES);
+        _pastSigValues[iSens][LEDpattern].clear();  // start filling the past signal buffer again
+        switched = true;
+      }
+      else
+      {
+        uint8_t up_iGI = calc_iGI(gainIndex[iSens][LEDpattern], integrationTimeIndex[iSens][LEDpattern], 1);
+        LOG_DEBUG("Switch up? predictedSwitchUpValue= "); LOG_DEBUGLN((uint32_t) ((uint64_t) pastValSum * GainIntegrationProduct[up_iGI] / GainIntegrationProduct[old_iGI] / NUM_PAST_SIGNAL_VALUES));
+        if (isPredictedOverflow(pastValSum, NUM_PAST_SIGNAL_VALUES, old_iGI, up_iGI) == false) {             // if switched up value will fall within the dynamic range, switch gain/inTime up
+          gainIntTimeUp(iSens, LEDpattern);                    // increase gain or integration time
+          traceGainSwitch(TRACE_GAIN_UP, iSens, LEDpattern, old_iGI, pastValSum / NUM_PAST_SIGNAL_VALUES);
+          _pastSigValues[iSens][LEDpattern].clear();  // start filling the past signal buffer again
+          switched = true;
+        }
+      }
+    }
+  }
+  return switched;
+}
+
+// record a gain/integration time switch in the trace buffer, switches that hit the lowest/highest setting and did not change anything are skipped
+TSL2591_TEMPLATE
+void TSL2591_CLASS::traceGainSwitch ( uint8_t event, uint8_t sensorSelect, uint8_t LEDpattern, uint8_t old_iGI, uint16_t value )
+{
+  uint8_t new_iGI = GainIntegrationIndex[gainIndex[sensorSelect][LEDpattern]][integrationTimeIndex[sensorSelect][LEDpattern]];
+  if (new_iGI != old_iGI)  Trace.record(event, sensorSelect, LEDpattern, old_iGI, new_iGI, value);
+}
+
+// jump to the highest gain/integration time that will not overflow, based on the last signal value.
+// Returns false if that is within one step of the current setting, small corrections are left to the
+// averaged stepwise switch so noise does not make the gain toggle.
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::predictGainIntTime ( uint8_t sensorSelect, uint8_t LEDpattern )
+{
+  uint16_t lastValue = _pastSigValues[sensorSelect][LEDpattern].newest();
+  uint8_t iGI = GainIntegrationIndex[gainIndex[sensorSelect][LEDpattern]][integrationTimeIndex[sensorSelect][LEDpattern]];
+  uint8_t new_iGI;
+
+  if (isOverflow(lastValue, integrationTimeIndex[sensorSelect][LEDpattern]))  {
+    new_iGI = 0;      // saturated, the real signal can't be predicted: fall back to the least sensitive setting
+  }
+  else  {
+    new_iGI = calcOptimal_iGI(lastValue, iGI);
+  }
+  if ((new_iGI + 1 >= iGI) && (new_iGI <= iGI + 1))  return false;
+
+  LOG_DEBUG("Sens"); LOG_DEBUG(sensorSelect); LOG_DEBUG("  ===> jump from iGI= "); LOG_DEBUG(iGI); LOG_DEBUG(" to iGI= "); LOG_DEBUGLN(new_iGI);
+  gainIndex[sensorSelect][LEDpattern] = iGI_GainIndex[new_iGI];
+  integrationTimeIndex[sensorSelect][LEDpattern] = iGI_IntegrationTimeIndex[new_iGI];
+  traceGainSwitch((new_iGI < iGI) ? TRACE_GAIN_DOWN : TRACE_GAIN_UP, sensorSelect, LEDpattern, iGI, lastValue);
+  return true;
+}
+
+// highest gain/integration time index at which the signal, scaled from its current iGI, stays below the overflow limit
+TSL2591_TEMPLATE
+uint8_t TSL2591_CLASS::calcOptimal_iGI ( uint16_t sensorVal, uint8_t iGI )
+{
+  for (uint8_t new_iGI = TSL2591_MAX_iGI; new_iGI > 0; new_iGI--)  {
+    if (isPredictedOverflow(sensorVal, 1, iGI, new_iGI) == false)  return new_iGI;
+  }
+  return 0;
+}
+
+// reduce signal by switching gain or integration time down
+TSL2591_TEMPLATE
+void TSL2591_CLASS::gainIntTimeDown ( uint8_t sensorSelect, uint8_t LEDpattern )
+{
+  uint8_t new_iGI = calc_iGI(gainIndex[sensorSelect][LEDpattern], integrationTimeIndex[sensorSelect][LEDpattern], -1);
+  uint8_t newGainIndex = iGI_GainIndex[new_iGI];
+  uint8_t newIntegrationTimeIndex = iGI_IntegrationTimeIndex[new_iGI];
+  LOG_DEBUG("Sens"); LOG_DEBUG(sensorSelect); LOG_DEBUG("  <--- switch down from G/I= ");
+  LOG_DEBUG(gainIndex[sensorSelect][LEDpattern]); LOG_DEBUG("/");  LOG_DEBUG(integrationTimeIndex[sensorSelect][LEDpattern]);
+  LOG_DEBUG(" to G/I= "); LOG_DEBUG(newGainIndex); LOG_DEBUG("/");  LOG_DEBUGLN(newIntegrationTimeIndex);
+
+  // stage new gain values, they are written to the sensor at the next acquisition of this LED pattern
+  gainIndex[sensorSelect][LEDpattern] = newGainIndex;
+  integrationTimeIndex[sensorSelect][LEDpattern] = newIntegrationTimeIndex;
+}
+
+// increase signal by switching gain or integration time down
+TSL2591_TEMPLATE
+void TSL2591_CLASS::gainIntTimeUp ( uint8_t sensorSelect, uint8_t LEDpattern )
+{
+  uint8_t new_iGI = calc_iGI(gainIndex[sensorSelect][LEDpattern], integrationTimeIndex[sensorSelect][LEDpattern], 1);
+  uint8_t newGainIndex = iGI_GainIndex[new_iGI];
+  uint8_t newIntegrationTimeIndex = iGI_IntegrationTimeIndex[new_iGI];
+  LOG_DEBUG("Sens"); LOG_DEBUG(sensorSelect); LOG_DEBUG("  ---> switch up from G/I= ");
+  LOG_DEBUG(gainIndex[sensorSelect][LEDpattern]); LOG_DEBUG("/");  LOG_DEBUG(integrationTimeIndex[sensorSelect][LEDpattern]);
+  LOG_DEBUG(" to G/I= "); LOG_DEBUG(newGainIndex); LOG_DEBUG("/");  LOG_DEBUGLN(newIntegrationTimeIndex);
+
+  // stage new gain values, they are written to the sensor at the next acquisition of this LED pattern
+  gainIndex[sensorSelect][LEDpattern] = newGainIndex;
+  integrationTimeIndex[sensorSelect][LEDpattern] = newIntegrationTimeIndex;
+}
+
+// calculate next combined gainIntegrationTimeValue
+TSL2591_TEMPLATE
+uint8_t TSL2591_CLASS::calc_iGI ( uint8_t iGain, uint8_t iIntTime, int indexStep)
+{
+  short new_iGI;  //needs to allow negative numbers
+  new_iGI = GainIntegrationIndex[iGain][iIntTime] + indexStep;              // switch N steps up or down
+  if (new_iGI <= 0) new_iGI = 0;                                             // stop if already on lowest gain
+  if (new_iGI >= TSL2591_MAX_iGI) new_iGI = TSL2591_MAX_iGI;                 // stop if already on highest gain
+  return (uint8_t) new_iGI;
+}
+
+// get the full spectrum data, marks the sample of the selected photodetector as read
+TSL2591_TEMPLATE
+uint16_t TSL2591_CLASS::getFullSpecSignal( uint8_t sensorSelect )
+{
+  _newSampleSensors &= ~(1 << sensorSelect);
+  return _fullSpecSignal[sensorSelect];
+}
+
+// get the IR spectrum data
+TSL2591_TEMPLATE
+uint16_t TSL2591_CLASS::getIRSpecSignal( uint8_t sensorSelect )
+{
+  return _IRSpecSignal[sensorSelect];
+}
+
+// true if the selected photodetector was read out since the last call of getFullSpecSignal
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::isNewSampleAvailable( uint8_t sensorSelect )
+{
+  return (_newSampleSensors & (1 << sensorSelect)) != 0;
+}
+
+// true if the last sample of the selected photodetector was taken in the middle of the acquisition (staggered mode),
+// its frame sample follows before poll() reports the acquisition as done
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::isIntermediateSample( uint8_t sensorSelect )
+{
+  return (_intermediateSensors & (1 << sensorSelect)) != 0;
+}
+
+// time of the last readout of the selected photodetector (ms)
+TSL2591_TEMPLATE
+uint32_t TSL2591_CLASS::getSampleTime( uint8_t sensorSelect )
+{
+  return _sampleTime[sensorSelect];
+}
+
+// last sample of a channel scaled to counts at 9876x gain and 600 ms integration time, independent of the gain/integration time it was taken with
+TSL2591_TEMPLATE
+uint32_t TSL2591_CLASS::getHDRSignal( uint8_t sensorSelect, uint8_t channel )
+{
+  uint16_t counts;
+  switch (channel)
+  {
+    case TSL2591_FULLSPECTRUM :
+      counts = _fullSpecSignal[sensorSelect];
+      break;
+    case TSL2591_INFRARED :
+      counts = _IRSpecSignal[sensorSelect];
+      break;
+    case TSL2591_VISIBLE :
+      counts = (_fullSpecSignal[sensorSelect] > _IRSpecSignal[sensorSelect]) ? _fullSpecSignal[sensorSelect] - _IRSpecSignal[sensorSelect] : 0;
+      break;
+    default:
+      return 0;
+  }
+  return (uint32_t) (((uint64_t) counts * HDRScale[_sample_iGI[sensorSelect]]) >> 16);
+}
+
+// true if the last sample of the photodetector is the first one after a gain/integration time switch (or the first one at all);
+// the HDR signal is continuous, but the step response of downstream filters may want to be reset
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::isGainSwitchSample( uint8_t sensorSelect )
+{
+  return (_gainSwitchSensors & (1 << sensorSelect)) != 0;
+}
+
+// false if the last readout of the photodetector failed or it is not present, its signal values are 0 then
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::isSampleValid( uint8_t sensorSelect )
+{
+  return (_validSensors & (1 << sensorSelect)) != 0;
+}
+
+// bit mask of photodetectors whose last sample is valid, bit 0 = sensor 0
+TSL2591_TEMPLATE
+uint8_t TSL2591_CLASS::getValidSensors( void )
+{
+  return _validSensors;
+}
+
+// check for an overflow
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::isOverflow(uint32_t sensorVal, uint8_t intTimeIndex)
+{
+  return sensorVal >= getOverflowLimit(intTimeIndex);
+}
+
+// ADC count at which the sensor saturates
+TSL2591_TEMPLATE
+uint32_t TSL2591_CLASS::getOverflowLimit( uint8_t intTimeIndex )
+{
+  if (intTimeIndex == 0)  return TSL2591_OVERFLOW_100MS;  // integration time = 100 ms?
+  return TSL2591_OVERFLOW;                                // any other integration time
+}
+
+// true if the average of numValues signal values taken at iGI, scaled to new_iGI, would overflow at new_iGI
+// including the switch buffer:  sum / numValues * GIP[new_iGI] / GIP[iGI] + buffer >= limit
+// Both sides are multiplied out so the comparison stays in integers, the Cortex-M0 has no FPU.
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::isPredictedOverflow( uint32_t sum, uint8_t numValues, uint8_t iGI, uint8_t new_iGI )
+{
+  uint32_t limit = getOverflowLimit(iGI_IntegrationTimeIndex[new_iGI]) - AUTO_GAIN_SWITCH_BUFFER;
+  if (new_iGI == iGI)  return sum >= limit * numValues;
+  return (uint64_t) sum * GainIntegrationProduct[new_iGI] >= (uint64_t) limit * numValues * GainIntegrationProduct[iGI];
+}
+
+// scan for sensors and return a bit mask of the sensors that answered
+TSL2591_TEMPLATE
+uint8_t TSL2591_CLASS::scanForSensors (void)
+{
+  uint8_t presentSensors = 0;
+
+  for (uint8_t ii = 0; ii < NUM_SENSORS; ii++)
+  {
+    if (probeSensor(ii))    presentSensors |= 1 << ii;
+  }
+
+  return presentSensors;
+}
+
+// bit mask of the sensors found by begin(), bit 0 = sensor 0
+TSL2591_TEMPLATE
+uint8_t TSL2591_CLASS::getPresentSensors( void )
+{
+  return _presentSensors;
+}
+
+TSL2591_TEMPLATE
+boolean TSL2591_CLASS::isSensorPresent( uint8_t sensorSelect )
+{
+  return (_presentSensors & (1 << sensorSelect)) != 0;
+}
+
+#undef TSL2591_TEMPLATE
+#undef TSL2591_CLASS
+
+#endif
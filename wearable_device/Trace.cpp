@@ -0,0 +1,50 @@
+/* Trace.cpp
+binary trace ring buffer for sensor diagnostics
+*/
+
+#include "Trace.h"
+
+TraceBuffer Trace;
+
+TraceBuffer::TraceBuffer(void)
+{
+  clear();
+}
+
+// number of records in the buffer
+uint8_t TraceBuffer::count( void )
+{
+  return _count;
+}
+
+// copy a record, index 0 is the oldest one. Returns false if there is no such record
+boolean TraceBuffer::get( uint8_t index, traceRecord_t *rec )
+{
+#if TRACE_BUFFER_SIZE > 0
+  if (index >= _count)  return false;
+  uint8_t pos = (_head + TRACE_BUFFER_SIZE - _count + index) % TRACE_BUFFER_SIZE;
+  *rec = _records[pos];
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TraceBuffer::clear( void )
+{
+  _head = 0;
+  _count = 0;
+}
+
+// print all records, oldest first
+void TraceBuffer::dump( Print &out )
+{
+  traceRecord_t rec;
+  out.print("--- trace: "); out.print(_count); out.println(" records ---");
+  for (uint8_t i = 0; get(i, &rec); i++)  {
+    out.print(rec.time); out.print(" ev="); out.print(rec.event);
+    out.print(" sens="); out.print(rec.sensor); out.print(" patt="); out.print(rec.LEDpattern);
+    out.print(" iGI="); out.print(rec.oldIndex); out.print("->"); out.print(rec.newIndex);
+    out.print(" val="); out.println(rec.value);
+  }
+}
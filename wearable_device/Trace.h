@@ -0,0 +1,79 @@
+/* Trace.h
+binary trace ring buffer for sensor diagnostics
+Records are written in a few cycles and only formatted when the buffer is dumped.
+*/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <Arduino.h>
+#include "Clock.h"
+
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE    32       // number of trace records kept, 0 disables tracing
+#endif
+
+typedef enum
+{
+  TRACE_GAIN_DOWN         = 1,    // gain/integration time switched down, value = averaged signal
+  TRACE_GAIN_UP           = 2,    // gain/integration time switched up, value = averaged signal
+  TRACE_AVALID_TIMEOUT    = 3,    // sensor never reported AVALID, read out after the worst-case time
+  TRACE_I2C_ERROR         = 4,    // I2C transaction failed after all retries, sensor = i2cDevice_t, old/new index = address/attempts, value = register
+  TRACE_I2C_RECOVERY      = 5,    // I2C bus was clocked free and the multiplexer reset, value = number of recoveries
+}
+traceEvent_t;
+
+// one trace record, old/new index are the combined gain/integration time index iGI
+typedef struct
+{
+  uint32_t  time;         // ms, SystemClock.now()
+  uint8_t   event;
+  uint8_t   sensor;
+  uint8_t   LEDpattern;
+  uint8_t   oldIndex;
+  uint8_t   newIndex;
+  uint8_t   reserved;
+  uint16_t  value;
+} traceRecord_t;          // 12 bytes
+
+class TraceBuffer
+{
+  public:
+    TraceBuffer();
+
+    inline void record( uint8_t event, uint8_t sensor, uint8_t LEDpattern, uint8_t oldIndex, uint8_t newIndex, uint16_t value );
+    uint8_t   count( void );
+    boolean   get( uint8_t index, traceRecord_t *rec );   // index 0 is the oldest record
+    void      clear( void );
+    void      dump( Print &out );       // print all records as text
+
+  private:
+#if TRACE_BUFFER_SIZE > 0
+    traceRecord_t  _records[TRACE_BUFFER_SIZE];
+#endif
+    uint8_t        _head;       // next record to write
+    uint8_t        _count;
+};
+
+extern TraceBuffer Trace;
+
+// store a record, overwrites the oldest one when the buffer is full
+inline void TraceBuffer::record( uint8_t event, uint8_t sensor, uint8_t LEDpattern, uint8_t oldIndex, uint8_t newIndex, uint16_t value )
+{
+#if TRACE_BUFFER_SIZE > 0
+  traceRecord_t *rec = &_records[_head];
+  rec->time = SystemClock.now();
+  rec->event = event;
+  rec->sensor = sensor;
+  rec->LEDpattern = LEDpattern;
+  rec->oldIndex = oldIndex;
+  rec->newIndex = newIndex;
+  rec->reserved = 0;
+  rec->value = value;
+  _head++;
+  if (_head >= TRACE_BUFFER_SIZE)  _head = 0;
+  if (_count < TRACE_BUFFER_SIZE)  _count++;
+#endif
+}
+
+#endif
@@ -13,6 +13,7 @@ Master code for wearable Strive Lactate Meter
  * 5: Able to write but not currently logging to file
  * 6: Failed to open file for writing
  * 7: Unable to initialize SD Card: Not recoverable
+ * 9: Logging paused, battery critical. Resumes (4) when the battery recovers, e.g. on the charger
  */
 // ============== TODO ======================
 // - change port 31 to input, read charging state
@@ -26,13 +27,25 @@ Master code for wearable Strive Lactate Meter
 #include <SD.h>
 #include <RFduinoBLE.h>
 #include <Wire.h>
-#include "Sensor_Tsl2591.h"
-#include "Led_Max6956.h"
+#include "Sensor_TSL2591.h"
+#include "LedBoard.h"
 #include "FuelGauge.h"
+#include "AmbientFilter.h"
+#include "RateScheduler.h"
+#include "BatteryMonitor.h"
+#include "LogFormat.h"
 
 #define PIN_WIRE_SDA         5
 #define PIN_WIRE_SCL         6
 #define POWER_BUTTON         3
+
+#define NUMBER_OF_SENSORS               4       // Number of sensors on PCB
+#define NUMBER_OF_PAST_SIGNAL_VALUES    3       // Number of past signal values to average before making a gain/iTime switch decision
+
+// sensor distances from the LEDs in mm, they name the sensor fields of the log
+const uint8_t SensorDistance[NUMBER_OF_SENSORS] = { 10, 20, 30, 40 };
+// the SD log records have a field per sensor
+typedef char logSensorCheck_t[(NUMBER_OF_SENSORS == LOG_NUMBER_OF_SENSORS) ? 1 : -1];
 Sd2Card card;
 /*
 // set up variables using the SD utility library functions:
@@ -43,6 +56,16 @@ SdFile root;
 
 const int chipSelect = 0;
 bool shouldSync = false;
+bool shouldDumpTrace = false;
+// BLE carries the ambient corrected frames, one per illuminated LED pattern and cycle. The SD log holds the raw frames
+// of every LED pattern, which the OS X App reads, and the corrected frames.
+// With raw frames on ('r'), the raw frames are sent as well, and the intermediate samples are sent and logged
+bool sendRawFrames = false;
+// the LEDs are switched to the next pattern, its acquisition waits for the rate scheduler
+bool patternPending = false;
+uint32_t patternSwitchTime = 0;   // ms, time the LEDs were switched to the pending pattern
+// the status LEDs belong to the animation while it plays, the button feedback is refreshed when it ends
+bool animationWasPlaying = false;
 // This will help debug errors since writing to the SD card means we can't use the Serial port
 // until the next iteration of the Dyno prototype
 int sd_card_status = 0;
@@ -50,23 +73,38 @@ int sd_card_status = 0;
 // We will write to this file
 File myFile;
 
-Sensor_TSL2591 Tsl;
-Led_MAX6956 LedDrv;
+Sensor_TSL2591<NUMBER_OF_SENSORS, NUMBER_OF_LED_PATTERNS, NUMBER_OF_PAST_SIGNAL_VALUES> Tsl;
+LedDriver LedDrv;
 FuelGauge Batt;
+AmbientFilter<NUMBER_OF_SENSORS, NUMBER_OF_LED_PATTERNS> Ambient(LED_PATTERN_DARK);
+RateScheduler Rate;
+BatteryMonitor Battery(&Batt);
+LedAnimator<LedDriver> Anim(&LedDrv);
+
+// status LED animations, played from loop() while the acquisition runs
+const ledKeyframe_t BootKeyframes[] = {
+  { 1 << BLUE_LED,  0, 600 },
+  { 1 << RED_LED,   0, 600 },
+  { 1 << GREEN_LED, 0, 600 },
+};
+const ledAnimation_t BootAnimation = { BootKeyframes, sizeof(BootKeyframes) / sizeof(BootKeyframes[0]), LED_ANIMATION_PRIORITY_STATUS };
 
 // debounce time (in ms)
-int debounce_time = 10;
+unsigned long debounce_time = 10;
 
 // maximum debounce timeout (in ms)
-int debounce_timeout = 100;
+unsigned long debounce_timeout = 100;
 
-char wfilename[30] = "log_0.txt";
+char wfilename[30] = "log_0" LOG_FILE_EXTENSION;
 
 /*
 * We have three structs, each with a leading byte.
 * 0 in the leading byte implies an infoStruct
 * 1 in the leading byte implies a detectorStruct
 * 2 in the leading byte implies an irStruct
+* 3 in the leading byte implies a correctedStruct
+* 4 in the leading byte implies a sampleStruct
+* 7 in the leading byte implies a traceStruct, 8 marks the end of a trace dump
 */
 
 // It is worth noting that 3 bytes are added to a struct
@@ -89,7 +127,8 @@ typedef struct
   unsigned short sensor_40mm;    	// 2 bytes
   byte gain_40mm;									// 1 byte
   byte intTime_40mm;							// 1 byte
-  // 2 bytes left
+  byte validSensors;              // 1 byte, bit n set if sensor n was read out without I2C error
+  // 1 byte left
 } detector_packet;
 
 // IR Values Struct
@@ -103,16 +142,40 @@ typedef struct {
 
 } ir_packet;
 
+// Ambient corrected signal of one LED pattern, gain-normalized to 9876x / 600 ms
+typedef struct {
+  byte infoByte;                  // 1 byte
+  byte LEDpattern;                // 1 byte
+  byte validSensors;              // 1 byte, bit n set if sensor n has a corrected signal, 1 byte padding
+  uint32_t sensor_10mm;           // 4 bytes
+  uint32_t sensor_20mm;           // 4 bytes
+  uint32_t sensor_30mm;           // 4 bytes
+  uint32_t sensor_40mm;           // 4 bytes
+} corrected_packet;
+
+// One intermediate sample of a single detector, read out while the slower detectors still integrate (staggered mode)
+typedef struct {
+  byte infoByte;                  // 1 byte
+  byte sensor;                    // 1 byte, 0 = 10 mm ... 3 = 40 mm
+  byte LEDpattern;                // 1 byte
+  byte gainIntTime;               // 1 byte, gain index << 4 | integration time index
+  int time;                       // 4 bytes, ms of the readout
+  unsigned short sensorSignal;    // 2 bytes, full spectrum
+  unsigned short irSignal;        // 2 bytes
+  byte valid;                     // 1 byte, 0 if the readout failed on the I2C bus
+  // 3 bytes padding
+} sample_packet;
+
 // Info data packet
 typedef struct {
   byte infoByte;									// 1 byte
   byte SDCardStatus;              // 1 byte
   int time; 											// 4 bytes
-  float cellVoltage; 							// 4 bytes
-  float stateOfCharge; 						// 4 bytes
+  unsigned short cellVoltage;     // 2 bytes, mV
+  unsigned short stateOfCharge;   // 2 bytes, 1/256 %
   unsigned short temp_skin;      	// 2 bytes
   unsigned short temp_amb;       	// 2 bytes
-  // 3 bytes left
+  // 4 bytes left
 } info_packet;
 
 
@@ -126,6 +189,12 @@ typedef struct {
   char fileNamed [15];  
 } file_packet;
 
+// Trace record, see Trace.h
+typedef struct {
+  byte infoByte;                  // 1 byte
+  traceRecord_t record;           // 12 bytes
+} trace_packet;
+
 typedef struct {
   byte infoByte;
   char fileNamed [15];  
@@ -136,7 +205,8 @@ void setup()
 {
   boolean stat;
   // Start I2C, serial, and BLE stack
-  Wire.beginOnPins(PIN_WIRE_SCL, PIN_WIRE_SDA);
+  I2C.begin(PIN_WIRE_SCL, PIN_WIRE_SDA, PIN_I2C_MUX_RESET);
+  I2C.setCallbacks(traceI2CError, traceI2CRecovery);
 
   // Cannot write to Serial while writing to the SD card, might corrupt the SD card otherwise
   Serial.begin(9600);
@@ -156,6 +226,14 @@ void setup()
   if (stat) {
     Serial.println("Light sensors OK");
   }
+  // read out each sensor as soon as its ADC reports valid data
+  Tsl.setWaitMode(TSL2591_WAIT_STATUS);
+  // keep sampling the near detectors while the far detectors integrate, loop() sends and logs every extra sample
+  Tsl.setScheduleMode(TSL2591_SCHEDULE_STAGGERED);
+  // configure and enable the sensors for the next LED pattern as soon as the previous frame is read out
+  Tsl.setPipelinedMode(true);
+  // jump straight to the right gain when the signal changes a lot, e.g. when the device is put on
+  Tsl.setGainMode(TSL2591_GAIN_PREDICTIVE);
   stat = Batt.begin();
   if (stat) {
     Serial.println("Fuel gauge OK");
@@ -173,20 +251,16 @@ void setup()
 
   Batt.reset();
   Batt.quickStart();
+  // low battery alert at BATTERY_LOW_SOC
+  Battery.begin();
 
     //Buttons
   pinMode(POWER_BUTTON, INPUT_PULLUP);
+  // wake up from the low-power wait between sensor readouts when the power button is pressed
+  RFduino_pinWake(POWER_BUTTON, LOW);
   
-  // Turn on blue status LED
-  LedDrv.RGBLedOn(BLUE_LED);
-  delay(600);
-  LedDrv.RGBLedOff(BLUE_LED);
-  LedDrv.RGBLedOn(RED_LED);
-  delay(600);
-  LedDrv.RGBLedOff(RED_LED);
-  LedDrv.RGBLedOn(GREEN_LED);
-  delay(600);
-  LedDrv.RGBLedOff(GREEN_LED);
+  // blue, red, green status LED; plays while the acquisition starts up
+  Anim.play(&BootAnimation);
 
   LedDrv.toggleLEDs_and_dark();
   LedDrv.toggleLEDs_and_dark();
@@ -205,7 +279,7 @@ void setup()
   if(!SD.exists("tracker.txt")) {
     File trackerFile = SD.open("tracker.txt", FILE_WRITE);
     if(trackerFile) {
-      trackerFile.println("filename = log_0.txt;");
+      trackerFile.println("filename = log_0" LOG_FILE_EXTENSION ";");
     }
     trackerFile.close();
   }
@@ -222,6 +296,8 @@ void loop()
   {
     Serial.println("Powerbutton pressed!");
     Serial.println("Going to sleep ... zzzz");
+    Anim.cancel();
+    Anim.update(SystemClock.now());
     LedDrv.LEDsOff();
     delay_until_button(LOW);
     delay(500);
@@ -230,30 +306,51 @@ void loop()
   detector_packet detectorStruct;
   info_packet infoStruct;
   ir_packet irStruct;
-  
-  if (LedDrv.isButton1Pressed())
-    LedDrv.RGBLedOn(GREEN_LED);
-  else
-    LedDrv.RGBLedOff(GREEN_LED);
 
-  if (LedDrv.isButton2Pressed())
-    LedDrv.RGBLedOn(BLUE_LED);
-  else
-    LedDrv.RGBLedOff(BLUE_LED);
+  bool animationPlaying = Anim.update(SystemClock.now());
 
-  //if (LedDrv.isCharging())
-  // LedDrv.RGBLedOn(RED_LED);
-  //else
-  //  LedDrv.RGBLedOff(RED_LED);
+  // one read of the buttons and the charge status pin, the status LEDs only change when an input does
+  bool inputsChanged = LedDrv.pollInputs();
+  if (!animationPlaying && (inputsChanged || animationWasPlaying)) {
+    if (LedDrv.isButton1Pressed())
+      LedDrv.RGBLedOn(GREEN_LED);
+    else
+      LedDrv.RGBLedOff(GREEN_LED);
 
-  float cellVoltage = Batt.getVCell();
-  float stateOfCharge = Batt.getSoC();
+    if (LedDrv.isButton2Pressed())
+      LedDrv.RGBLedOn(BLUE_LED);
+    else
+      LedDrv.RGBLedOff(BLUE_LED);
 
-  // toggle 660nm and  855 nm LEDs
-  LedDrv.toggleLEDs_and_dark();
-  //  LedDrv.nextLED();
+    //if (LedDrv.isCharging())
+    // LedDrv.RGBLedOn(RED_LED);
+    //else
+    //  LedDrv.RGBLedOff(RED_LED);
+  }
+  animationWasPlaying = animationPlaying;
+
+  // start the first acquisition, or the next cycle once the rate scheduler lets it start;
+  // otherwise the next one is started as soon as a frame is read out
+  if (!Tsl.isAcquisitionRunning()) {
+    if (!patternPending) {
+      nextLEDpattern();
+    }
+    if (!beginPatternWhenDue()) {
+      sleepFor(Rate.getIdleTime(SystemClock.now()));
+      return;
+    }
+  }
 
-  Tsl.startAcquisition(LedDrv.getCurrentLEDpattern());
+  // advance the acquisition; everything below only runs when new sensor data is available.
+  // Until the next ADC can be done there is nothing to do, so sleep instead of spinning through loop().
+  // A power button press wakes the core early.
+  if (!Tsl.poll(SystemClock.now())) {
+    sendSensorSamples();
+    sleepFor(Tsl.getIdleTime(SystemClock.now()));
+    return;
+  }
+  // one cycle per frame, the active/sleep split of the last one is printed with the trace dump
+  SystemClock.startCycle();
 
   unsigned short det1FS = Tsl.getFullSpecSignal(0);
   unsigned short det2FS = Tsl.getFullSpecSignal(1);
@@ -287,80 +384,103 @@ void loop()
   detectorStruct.intTime_30mm = Tsl.getIntegrationTimeIndex(2);
   detectorStruct.gain_40mm = Tsl.getGainIndex(3);
   detectorStruct.intTime_40mm = Tsl.getIntegrationTimeIndex(3);
+  detectorStruct.validSensors = Tsl.getValidSensors();
+
+  // ambient light correction: every dark frame completes the illuminated frames before it
+  uint32_t hdrSignal[NUMBER_OF_SENSORS];
+  uint32_t sampleTime[NUMBER_OF_SENSORS];
+  for (uint8_t i = 0; i < NUMBER_OF_SENSORS; i++) {
+    hdrSignal[i] = Tsl.getHDRSignal(i, TSL2591_FULLSPECTRUM);
+    sampleTime[i] = Tsl.getSampleTime(i);
+  }
+  boolean haveCorrectedFrame = Ambient.addFrame(detectorStruct.LEDpattern, hdrSignal, sampleTime, detectorStruct.validSensors);
+
+  // switch to the next LED pattern and start its acquisition right away (pipelined mode),
+  // so it integrates while this frame is processed, logged and sent
+  // (at a reduced rate the next cycle may have to wait, the LEDs stay dark until then)
+  uint8_t framePattern = detectorStruct.LEDpattern;
+  nextLEDpattern();
+  beginPatternWhenDue();
+
+  // VCELL, SOC and the low battery alert in one read, at most once per fuel gauge refresh interval
+  if(Battery.update(SystemClock.now())) {
+    Rate.setLowBattery(Battery.getState() != BATTERY_OK);
+  }
+  // Status 9: logging paused, a brownout in the middle of a write could corrupt the log.
+  // The workout goes on, so logging resumes once the cell voltage is out of the critical range
+  if(sd_card_status == 4 && Battery.getState() == BATTERY_CRITICAL) {
+    sd_card_status = 9;
+  }
+  else if(sd_card_status == 9 && Battery.getState() != BATTERY_CRITICAL) {
+    sd_card_status = 4;
+  }
+  uint16_t cellVoltage = Batt.getVCellMillivolts();
+  uint16_t stateOfCharge = Batt.getSoCFixed();
 
   /// --- make some space in the data package and send the IR signal values as well via Bluetooth ---
 
   infoStruct.infoByte = 0;
-  infoStruct.time = millis();
+  infoStruct.time = SystemClock.now();
   infoStruct.cellVoltage = cellVoltage;
   infoStruct.stateOfCharge = stateOfCharge;
   infoStruct.temp_skin = 0;
   infoStruct.temp_amb = RFduino_temperature(CELSIUS);
 
-  Tsl.autoAdjustGain();
+  Tsl.autoAdjustGain(framePattern);
   
   
   if(sd_card_status == 4) {
-
-    // Initialize card every time so the firmware does not crash if the SD card is removed while the 
-  // loop is running
-    if(!card.init(SPI_HALF_SPEED, chipSelect)) {
-      sd_card_status = 7;
+    // binary records, tools/sdlog2txt converts the file to the OS X App log format
+    logRecord_t record;
+    memset(&record, 0, sizeof(record));
+    record.time = infoStruct.time;
+    record.cellVoltage = cellVoltage;
+    record.stateOfCharge = stateOfCharge;
+    record.tempSkin = infoStruct.temp_skin;
+    record.tempAmb = infoStruct.temp_amb;
+    record.sensor[0] = detectorStruct.sensor_10mm;
+    record.sensor[1] = detectorStruct.sensor_20mm;
+    record.sensor[2] = detectorStruct.sensor_30mm;
+    record.sensor[3] = detectorStruct.sensor_40mm;
+    record.ir[0] = irStruct.ir_10mm;
+    record.ir[1] = irStruct.ir_20mm;
+    record.ir[2] = irStruct.ir_30mm;
+    record.ir[3] = irStruct.ir_40mm;
+    record.gainIntTime[0] = (detectorStruct.gain_10mm << LOG_GAIN_SHIFT) | detectorStruct.intTime_10mm;
+    record.gainIntTime[1] = (detectorStruct.gain_20mm << LOG_GAIN_SHIFT) | detectorStruct.intTime_20mm;
+    record.gainIntTime[2] = (detectorStruct.gain_30mm << LOG_GAIN_SHIFT) | detectorStruct.intTime_30mm;
+    record.gainIntTime[3] = (detectorStruct.gain_40mm << LOG_GAIN_SHIFT) | detectorStruct.intTime_40mm;
+    record.LEDpattern = detectorStruct.LEDpattern;
+    record.validSensors = detectorStruct.validSensors;
+    record.recordType = LOG_RECORD_FRAME;
+    writeLogRecord(record);
+    if(haveCorrectedFrame) {
+      logCorrectedFrames(record);
     }
-    // Write to SD card here
-     
-   else {
-        
-        myFile = SD.open(wfilename, FILE_WRITE); //wfilename
-        if(myFile) {
-
-            // Log in the same format as our OS X App log file
-            myFile.printf("\"cell_voltage\" = %f;\n", cellVoltage);
-            myFile.printf("\"gain_10mm\" = %d;\n", detectorStruct.gain_10mm);
-            myFile.printf("\"gain_20mm\" = %d;\n", detectorStruct.gain_20mm);
-            myFile.printf("\"gain_30mm\" = %d;\n", detectorStruct.gain_30mm);
-            myFile.printf("\"gain_40mm\" = %d;\n", detectorStruct.gain_40mm);
-            myFile.printf("\"intTime_10mm\" = %d;\n", detectorStruct.intTime_10mm);
-            myFile.printf("\"intTime_20mm\" = %d;\n", detectorStruct.intTime_20mm);
-            myFile.printf("\"intTime_30mm\" = %d;\n", detectorStruct.intTime_30mm);
-            myFile.printf("\"intTime_40mm\" = %d;\n", detectorStruct.intTime_40mm);
-            myFile.printf("\"ir_10mm\" = %d;\n", irStruct.ir_10mm);
-            myFile.printf("\"ir_20mm\" = %d;\n", irStruct.ir_20mm);
-            myFile.printf("\"ir_30mm\" = %d;\n", irStruct.ir_30mm);
-            myFile.printf("\"ir_40mm\" = %d;\n", irStruct.ir_40mm);
-            myFile.printf("ledStatus: %d;\n", detectorStruct.LEDpattern);
-            myFile.printf("\"sensor_10mm\" = %d;\n", detectorStruct.sensor_10mm);
-            myFile.printf("\"sensor_20mm\" = %d;\n", detectorStruct.sensor_20mm);
-            myFile.printf("\"sensor_30mm\" = %d;\n", detectorStruct.sensor_30mm);
-            myFile.printf("\"sensor_40mm\" = %d;\n", detectorStruct.sensor_40mm);
-            myFile.printf("\"state_of_charge\" = %f;\n", stateOfCharge);
-            myFile.printf("\"temp_skin\" = %d;\n", infoStruct.temp_skin);
-            myFile.printf("\"temp_amb\" = %d;\n", infoStruct.temp_amb);
-            myFile.printf("time = %d;\n\n", infoStruct.time);
-           // myFile.println(detectorStruct.sensor_10mm);
-     
-            // Close the file connection here
-            myFile.close();
-            // Success!
-        } else {
-           // Error code 6: Failed to open file
-           sd_card_status = 6;
-        }
-   }
   }
   
   infoStruct.SDCardStatus = sd_card_status;
 
   // Send all structs in succession, eliminating the need for a second loop
   // It is important that we send these in this order because of the infoByte
+  // on a low battery only the info packet is sent, the measurement is logged only
   RFduinoBLE.send((char *)&infoStruct, sizeof(infoStruct));
-  RFduinoBLE.send((char *)&detectorStruct, sizeof(detectorStruct));
-  RFduinoBLE.send((char *)&irStruct, sizeof(irStruct));
+  boolean streaming = (Battery.getState() == BATTERY_OK);
+  if(streaming && sendRawFrames) {
+    RFduinoBLE.send((char *)&detectorStruct, sizeof(detectorStruct));
+    RFduinoBLE.send((char *)&irStruct, sizeof(irStruct));
+  }
+  if(streaming && haveCorrectedFrame) {
+    sendCorrectedFrames();
+  }
 
   // Sync if sync is on
   if(shouldSync) {
     syncData();
   }
+  if(shouldDumpTrace) {
+    dumpTrace();
+  }
 }
 
 void RFduinoBLE_onReceive(char *data, int len) {
@@ -368,12 +488,35 @@ void RFduinoBLE_onReceive(char *data, int len) {
   if(data[0] == 's') {
     shouldSync = true;
   }
+  // t is dump trace buffer
+  else if(data[0] == 't') {
+    shouldDumpTrace = true;
+  }
+  // p<profile> is fix the rate profile (0xFF = automatic), p<profile><period lo><period hi> also sets its cycle period in ms
+  else if(data[0] == 'p') {
+    if(len >= 4) {
+      Rate.setCyclePeriod(data[1], (uint8_t)data[2] | ((uint16_t)(uint8_t)data[3] << 8));
+    }
+    if(len >= 2) {
+      Rate.setProfileOverride(data[1]);
+    }
+  }
+  // c is send ambient corrected frames only, r is send raw frames and samples as well and log the samples
+  else if(data[0] == 'c') {
+    sendRawFrames = false;
+  }
+  else if(data[0] == 'r') {
+    sendRawFrames = true;
+  }
   // 4 is write 
   else if(data[0] == '4') {
       sd_card_status = 4;
+      // logging means a workout is running
+      Rate.setWorkout(true);
     } else {
       // 5 is writeable but not writing at the moment
       sd_card_status = 5;
+      Rate.setWorkout(false);
       /*
        * Split into multiple files here to mimic a stop button
        * 
@@ -384,14 +527,14 @@ void RFduinoBLE_onReceive(char *data, int len) {
         while(SD.exists(wfilename)) {
           
           tmpStr = "log_" + (String) i;
-          tmpStr += ".txt";
+          tmpStr += LOG_FILE_EXTENSION;
           /*
           File tmpFile = SD.open("errors.txt", FILE_WRITE);
           tmpFile.println(tmpStr);
           tmpFile.println("\n");
           tmpFile.close();
           */
-          for(int j = 0; j < tmpStr.length(); j++) {
+          for(unsigned int j = 0; j < tmpStr.length(); j++) {
             wfilename[j] = tmpStr[j];
           }
           i += 1;
@@ -420,7 +563,7 @@ String extractData(String str) {
   //Serial.println(str);
   String finalVal = "";
   bool foundEquals = false;
-  for(int i = 0; i < str.length(); i++) {
+  for(unsigned int i = 0; i < str.length(); i++) {
     char tmp = str[i];
     if(tmp == '=' || tmp == ':') {
       foundEquals = true;
@@ -438,14 +581,15 @@ String extractData(String str) {
 }
 
 void RFduinoBLE_onConnect() {
+  Rate.setConnected(true);
   // Increment file counter to write to a new file on a new connection
   int i = 0;
         String tmpStr = "log_" ;
         while(SD.exists(wfilename)) {
           
           tmpStr = "log_" + (String) i;
-          tmpStr += ".txt";
-          for(int j = 0; j < tmpStr.length(); j++) {
+          tmpStr += LOG_FILE_EXTENSION;
+          for(unsigned int j = 0; j < tmpStr.length(); j++) {
             wfilename[j] = tmpStr[j];
           }
           i += 1;
@@ -468,6 +612,257 @@ void RFduinoBLE_onConnect() {
 void RFduinoBLE_onDisconnect() {
   // Turn off syncing
   shouldSync = false;
+  Rate.setConnected(false);
+}
+
+/*
+ * Low-power wait, cut short when the status LED animation needs its next keyframe.
+ * A power button press ends it early. Its wake flag stays latched and would end
+ * every following wait at once, so it is reset here for all callers.
+ */
+void sleepFor(uint32_t idleTime) {
+  uint32_t animationIdleTime = Anim.getIdleTime(SystemClock.now());
+  SystemClock.sleep(idleTime < animationIdleTime ? idleTime : animationIdleTime);
+  if (RFduino_pinWoke(POWER_BUTTON)) {
+    RFduino_resetPinWake(POWER_BUTTON);
+  }
+}
+
+/*
+ * Switches the LEDs to the next pattern the rate scheduler wants acquired.
+ * The dark pattern is always part of the set, so this ends after at most one full round.
+ */
+void nextLEDpattern() {
+  uint8_t pattern = LedDrv.getCurrentLEDpattern();
+  for(uint8_t i = 0; i < NUMBER_OF_LED_PATTERNS; i++) {
+    pattern = (pattern + 1) % NUMBER_OF_LED_PATTERNS;
+    if(Rate.isPatternEnabled(pattern)) {
+      break;
+    }
+  }
+  LedDrv.applyLEDpattern(pattern);    // skipped patterns are never written to the LED driver
+  patternSwitchTime = SystemClock.now();
+  patternPending = true;
+}
+
+/*
+ * Starts the acquisition of the pending LED pattern. A new cycle
+ * (dark pattern) only starts when the rate scheduler says it is due.
+ */
+boolean beginPatternWhenDue() {
+  uint32_t now = SystemClock.now();
+  if(LedDrv.getCurrentLEDpattern() == LED_PATTERN_DARK) {
+    if(!Rate.isCycleDue(now)) {
+      return false;
+    }
+    Rate.startCycle(now);
+  }
+  // some LED patterns need time to settle before the integration starts
+  uint32_t settledTime = patternSwitchTime + LedDrv.getPatternSettleTime(LedDrv.getCurrentLEDpattern());
+  if((int32_t)(settledTime - now) > 0) {
+    SystemClock.sleep(settledTime - now);
+    now = SystemClock.now();
+  }
+  Tsl.beginAcquisition(LedDrv.getCurrentLEDpattern(), now);
+  patternPending = false;
+  return true;
+}
+
+/*
+ * Sends one correctedStruct per illuminated LED pattern
+ * that was completed by the last dark frame. Sensors without
+ * a valid sample pair are 0 and not set in validSensors.
+ */
+void sendCorrectedFrames() {
+  corrected_packet correctedStruct;
+  correctedStruct.infoByte = 3;
+
+  for(uint8_t pattern = 0; pattern < NUMBER_OF_LED_PATTERNS; pattern++) {
+    if(!Ambient.isCorrected(pattern)) {
+      continue;
+    }
+    correctedStruct.LEDpattern = pattern;
+    correctedStruct.validSensors = Ambient.getValidSensors(pattern);
+    correctedStruct.sensor_10mm = Ambient.getCorrectedSignal(pattern, 0);
+    correctedStruct.sensor_20mm = Ambient.getCorrectedSignal(pattern, 1);
+    correctedStruct.sensor_30mm = Ambient.getCorrectedSignal(pattern, 2);
+    correctedStruct.sensor_40mm = Ambient.getCorrectedSignal(pattern, 3);
+    RFduinoBLE.send((char *)&correctedStruct, sizeof(correctedStruct));
+  }
+}
+
+/*
+ * Logs one corrected record per illuminated LED pattern that was completed
+ * by the last dark frame. The time, battery and temperature fields are the
+ * ones of the dark frame's record, the raw sensor fields are cleared.
+ */
+void logCorrectedFrames(logRecord_t record) {
+  record.recordType = LOG_RECORD_CORRECTED;
+  record.sampleSensor = 0;
+  for(uint8_t i = 0; i < NUMBER_OF_SENSORS; i++) {
+    record.sensor[i] = 0;
+    record.ir[i] = 0;
+    record.gainIntTime[i] = 0;
+  }
+
+  for(uint8_t pattern = 0; pattern < NUMBER_OF_LED_PATTERNS; pattern++) {
+    if(!Ambient.isCorrected(pattern)) {
+      continue;
+    }
+    record.LEDpattern = pattern;
+    record.validSensors = Ambient.getValidSensors(pattern);
+    for(uint8_t i = 0; i < NUMBER_OF_SENSORS; i++) {
+      record.corrected[i] = Ambient.getCorrectedSignal(pattern, i);
+    }
+    writeLogRecord(record);
+  }
+}
+
+/*
+ * Sends the trace buffer as one traceStruct per record, oldest first,
+ * followed by infoByte 8. The same records are printed on the serial port.
+ */
+void dumpTrace() {
+  trace_packet traceStruct;
+  sync_packet traceEnd;
+  traceStruct.infoByte = 7;
+  traceEnd.infoByte = 8;
+
+  Trace.dump(Serial);
+  Serial.print("last cycle active/sleep ms: ");
+  Serial.print(SystemClock.getCycleActiveTime());
+  Serial.print(" / ");
+  Serial.println(SystemClock.getCycleSleepTime());
+  for(uint8_t i = 0; Trace.get(i, &traceStruct.record); i++) {
+    RFduinoBLE.send((char *)&traceStruct, sizeof(traceStruct));
+  }
+  RFduinoBLE.send((char *)&traceEnd, sizeof(traceEnd));
+  shouldDumpTrace = false;
+}
+
+/*
+ * Called by I2C when a transaction failed after all retries, device is an i2cDevice_t.
+ */
+void traceI2CError(uint8_t device, uint8_t address, uint8_t reg) {
+  LOG_ERROR(" I2C error, device "); LOG_ERROR(device); LOG_ERROR(" register "); LOG_ERRORLN(reg);
+  Trace.record(TRACE_I2C_ERROR, device, 0, address, I2C_MAX_ATTEMPTS, reg);
+}
+
+/*
+ * Called by I2C when it clocked the bus free and reset the multiplexer.
+ */
+void traceI2CRecovery(uint16_t recoveryCount) {
+  LOG_ERRORLN(" I2C bus recovered");
+  Trace.record(TRACE_I2C_RECOVERY, 0, 0, 0, 0, recoveryCount);
+}
+
+/*
+ * Staggered mode: the near detectors are read out several times while the far detectors integrate.
+ * With raw frames on, each intermediate sample is sent as a sampleStruct and logged as a sample record
+ * right away, before the next readout of the detector replaces it. The frame sample goes out with the frame.
+ */
+void sendSensorSamples() {
+  if(!sendRawFrames) {
+    return;
+  }
+  sample_packet sampleStruct;
+  sampleStruct.infoByte = 4;
+  boolean streaming = (Battery.getState() == BATTERY_OK);
+
+  for(uint8_t i = 0; i < NUMBER_OF_SENSORS; i++) {
+    if(!Tsl.isNewSampleAvailable(i) || !Tsl.isIntermediateSample(i)) {
+      continue;
+    }
+    sampleStruct.sensor = i;
+    sampleStruct.LEDpattern = Tsl.getCurrentLEDpattern();
+    sampleStruct.gainIntTime = (Tsl.getGainIndex(i) << LOG_GAIN_SHIFT) | Tsl.getIntegrationTimeIndex(i);
+    sampleStruct.time = Tsl.getSampleTime(i);
+    sampleStruct.sensorSignal = Tsl.getFullSpecSignal(i);
+    sampleStruct.irSignal = Tsl.getIRSpecSignal(i);
+    sampleStruct.valid = Tsl.isSampleValid(i);
+
+    if(sd_card_status == 4) {
+      logRecord_t record;
+      memset(&record, 0, sizeof(record));
+      record.time = sampleStruct.time;
+      record.cellVoltage = Batt.getVCellMillivolts();
+      record.stateOfCharge = Batt.getSoCFixed();
+      record.tempAmb = RFduino_temperature(CELSIUS);
+      record.sensor[i] = sampleStruct.sensorSignal;
+      record.ir[i] = sampleStruct.irSignal;
+      record.gainIntTime[i] = sampleStruct.gainIntTime;
+      record.LEDpattern = sampleStruct.LEDpattern;
+      record.validSensors = sampleStruct.valid ? (1 << i) : 0;
+      record.recordType = LOG_RECORD_SAMPLE;
+      record.sampleSensor = i;
+      writeLogRecord(record);
+    }
+    if(streaming) {
+      RFduinoBLE.send((char *)&sampleStruct, sizeof(sampleStruct));
+    }
+  }
+}
+
+/*
+ * Appends one record to the log file, a new file starts with the log header
+ */
+void writeLogRecord(logRecord_t &record) {
+  // Initialize card every time so the firmware does not crash if the SD card is removed while the 
+  // loop is running
+  if(!card.init(SPI_HALF_SPEED, chipSelect)) {
+    sd_card_status = 7;
+    return;
+  }
+  myFile = SD.open(wfilename, FILE_WRITE); //wfilename
+  if(myFile) {
+    if(myFile.size() == 0) {
+      writeLogHeader(myFile);
+    }
+    myFile.write((const uint8_t *)&record, sizeof(record));
+    // Close the file connection here
+    myFile.close();
+    // Success!
+  } else {
+    // Error code 6: Failed to open file
+    sd_card_status = 6;
+  }
+}
+
+/*
+ * Writes the binary log file header, the first thing in every log file
+ */
+void writeLogHeader(File &file) {
+  logFileHeader_t header;
+  memcpy(header.magic, LOG_FORMAT_MAGIC, LOG_FORMAT_MAGIC_LENGTH);
+  header.version = LOG_FORMAT_VERSION;
+  header.headerSize = sizeof(logFileHeader_t);
+  header.recordSize = sizeof(logRecord_t);
+  header.numberOfSensors = NUMBER_OF_SENSORS;
+  header.numberOfLedPatterns = NUMBER_OF_LED_PATTERNS;
+  for(uint8_t i = 0; i < NUMBER_OF_SENSORS; i++) {
+    header.sensorDistance[i] = SensorDistance[i];
+  }
+  memset(header.reserved, 0, sizeof(header.reserved));
+  file.write((const uint8_t *)&header, sizeof(header));
+}
+
+/*
+ * Reads and checks the log file header and moves to the first record.
+ * Only files with this firmware's record layout are synced,
+ * tools/sdlog2txt also reads other format versions.
+ */
+boolean readLogHeader(File &file) {
+  logFileHeader_t header;
+  if(file.read(&header, sizeof(header)) != (int)sizeof(header)) {
+    return false;
+  }
+  if(memcmp(header.magic, LOG_FORMAT_MAGIC, LOG_FORMAT_MAGIC_LENGTH) != 0
+     || header.version != LOG_FORMAT_VERSION
+     || header.recordSize != sizeof(logRecord_t)
+     || header.numberOfSensors != NUMBER_OF_SENSORS) {
+    return false;
+  }
+  return file.seek(header.headerSize);
 }
 
 /*
@@ -475,9 +870,9 @@ void RFduinoBLE_onDisconnect() {
  * This method looks for a tracker.txt file
  * and then uses the lines in that file to 
  * get a list of all the files it needs to sync
- * It then takes all the lines in the list, takes each line,
- * parses it, and then converts it to the appropriate data type
- * and then sends it to the device, after packing it in a struct
+ * It then reads the binary records of each file (see LogFormat.h),
+ * unpacks them into the packets the live data uses (sendLogRecord)
+ * and then sends them to the device
  * Sync codes are used to begin and terminate the sync operations
  * 32: Start Sync, 42: End Sync 
  * Do not delete the tracker.txt file, or change it, as that will affect 
@@ -491,7 +886,6 @@ void syncData() {
   File trackerFile = SD.open("tracker.txt");
   sync_packet syncStatus;
   file_packet fileStruct;
-  file_packet2 fileStruct2;
   
   if(trackerFile) {
     
@@ -518,21 +912,13 @@ void syncData() {
         //String prefix = "Logs/";
         String finalName = filename;
         char tempname [19] = "";
-        finalName.toCharArray(tempname, sizeof(finalName));
-        filename.toCharArray(fileStruct.fileNamed, sizeof(filename));
-        filename.toCharArray(fileStruct2.fileNamed, sizeof(filename));
+        // sizes of the buffers, not of the String objects
+        finalName.toCharArray(tempname, sizeof(tempname));
+        filename.toCharArray(fileStruct.fileNamed, sizeof(fileStruct.fileNamed));
+        filename.toCharArray(fileStruct2.fileNamed, sizeof(fileStruct2.fileNamed));
         Serial.println("Now opening file");
         //Serial.println(tempname);
         
-        // Define the structs we plan on using here
-        detector_packet detectorStruct;
-        info_packet infoStruct;
-        ir_packet irStruct;
-        
-        infoStruct.SDCardStatus = 0;
-        infoStruct.infoByte = 0;
-        detectorStruct.infoByte = 1;
-        irStruct.infoByte = 2;
         fileStruct.infoByte = 6;
 
         
@@ -542,211 +928,27 @@ void syncData() {
        //char tempname [] = "Logs/log_1.txt";
        File dataFile = SD.open(tempname);
 
-      /*
-       * Data is logged to, and thus read from the SD card in the following order
-       * Maps to the numbers on the left
-       * 0: "cell_voltage"
-       * 1: "gain_10mm"
-       * 2: "gain_20mm"
-       * 3: "gain_30mm"
-       * 4: "gain_40mm"
-       * 5: "intTime_10mm"
-       * 6: "intTime_20mm"
-       * 7: "intTime_30mm"
-       * 8: "intTime_40mm"
-       * 9: "ir_10mm"
-       * 10: "ir_20mm"
-       * 11: "ir_30mm"
-       * 12: "ir_40mm"
-       * 13: ledStatus
-       * 14: "sensor_10mm"
-       * 15: "sensor_20mm"
-       * 16: "sensor_30mm"
-       * 17: "sensor_40mm"
-       * 18: "state_of_charge"
-       * 19: "temp_skin"
-       * 20: "temp_amb"
-       * 21: time
-       */
       // if the file is available, read from it:
       if (dataFile) {
-        int counter = -1;
-        String line = "";
-        while (dataFile.available()) {
-          int a = dataFile.read();
-          int b = dataFile.peek();
-          if((char)b == ';') {
-            line += (char)a;
-            line += ';';
-            counter++;
-            String extVal = extractData(line);
-
-            if(counter == 0) {
-          
-               // Cell Voltage  
-              // Convert to float
-              char man [] = "";
-              extVal.toCharArray(man, sizeof(extVal));
-              float cell_voltage = atof(man);
-              infoStruct.cellVoltage = cell_voltage;
-          
-            } else if(counter == 1) {
-          
-              // gain_10mm
-             // Convert to byte
-             detectorStruct.gain_10mm = extVal.toInt();
-          
-            } else if(counter == 2) {
-
-              // gain_20mm
-             // Convert to byte
-             detectorStruct.gain_20mm = extVal.toInt();
-          
-           } else if(counter == 3) {
-
-             // gain_30mm
-            // Convert to byte
-            detectorStruct.gain_30mm = extVal.toInt();
-          
-          } else if(counter == 4) {
-
-            // gain_40mm
-            // Convert to byte
-            detectorStruct.gain_40mm = extVal.toInt();
-          
-          } else if(counter == 5) {
-
-            // intTime_10mm
-            // Convert to byte
-            detectorStruct.intTime_10mm = extVal.toInt();
-          
-          } else if(counter == 6) {
-
-            // intTime_20mm
-            // Convert to byte
-            detectorStruct.intTime_20mm = extVal.toInt();
-         
-          } else if(counter == 7) {
-
-            // intTime_30mm
-            // Convert to byte
-            detectorStruct.intTime_30mm = extVal.toInt();
-         
-          } else if(counter == 8) {
-
-            // intTime_40mm
-            // Convert to byte
-            detectorStruct.intTime_40mm = extVal.toInt();
-         
-          } else if(counter == 9) {
-
-            // ir_10mm
-            // Convert to byte
-            irStruct.ir_10mm = extVal.toInt();
-         
-          } else if(counter == 10) {
-          
-            // ir_20mm
-            // Convert to byte
-            irStruct.ir_20mm = extVal.toInt();
-       
-          } else if(counter == 11) {
-          
-            // ir_30mm
-            // Convert to byte
-            irStruct.ir_30mm = extVal.toInt();
-       
-          } else if(counter == 12) {
-        
-            // ir_40mm
-            // Convert to byte
-            irStruct.ir_40mm = extVal.toInt();
-       
-          } else if(counter == 13) {
-          
-            // ledStatus
-            // Convert to byte
-            detectorStruct.LEDpattern = extVal.toInt();
-       
-          } else if(counter == 14) {
-
-            // sensor_10mm
-            // Convert to short
-            detectorStruct.sensor_10mm = extVal.toInt();
-          
-          } else if(counter == 15) {
-
-            // sensor_20mm
-            // Convert to short
-            detectorStruct.sensor_20mm = extVal.toInt();
-          
-          } else if(counter == 16) {
-
-            // sensor_30mm
-            // Convert to short
-            detectorStruct.sensor_30mm = extVal.toInt();
-          
-          } else if(counter == 17) {
-
-            // sensor_40mm
-            // Convert to short
-            detectorStruct.sensor_40mm = extVal.toInt();
-          
-          } else if(counter == 18) {
-
-            // State of Charge
-            // Convert to float
-            char man [] = "";
-            extVal.toCharArray(man, sizeof(extVal));
-            float state_of_charge = atof(man);
-            infoStruct.stateOfCharge = state_of_charge;
-          
-          } else if(counter == 19) {
-
-            // Skin temperature
-            // Convert to short
-            infoStruct.temp_skin = extVal.toInt();
-          
-          } else if(counter == 20) {
-
-            // Amb. temperature
-            // Convert to short
-            infoStruct.temp_amb = extVal.toInt();
-          
-          } else if(counter == 21) {
-             // Reset counter here
-             counter = -1;
-            // Time
-            // Convert to Int
-            infoStruct.time = extVal.toInt();
-
-           // Send filename here
-           //fileStruct.fileNamed = tempname;
-           RFduinoBLE.send((char *)&fileStruct, sizeof(fileStruct));
+        logRecord_t record;
+        // a record cut short by a power loss at the end of the file is dropped
+        boolean validFile = readLogHeader(dataFile);
+        while (validFile && dataFile.read(&record, sizeof(record)) == (int)sizeof(record)) {
+          // Send filename here
+          RFduinoBLE.send((char *)&fileStruct, sizeof(fileStruct));
           // Send structs here
-          RFduinoBLE.send((char *)&infoStruct, sizeof(infoStruct));
-          RFduinoBLE.send((char *)&detectorStruct, sizeof(detectorStruct));
-          RFduinoBLE.send((char *)&irStruct, sizeof(irStruct));
-          
+          sendLogRecord(record);
         }
-        line = "";
-      } else {
-        
-        line += (char)a;
-      }
-      //counter++; 
-    }
 
-    // Send end signal here
-    RFduinoBLE.send((char *)&fileStruct2, sizeof(fileStruct2));
-    dataFile.close();  
-    Serial.println("File connection closed");
-    
-  }
-  // if the file isn't open, pop up an error:
-  else {
-    Serial.println("error opening log_0.txt");
-  }     
+        // Send end signal here
+        RFduinoBLE.send((char *)&fileStruct2, sizeof(fileStruct2));
+        dataFile.close();  
+        Serial.println("File connection closed");
+      }
+      // if the file isn't open, pop up an error:
+      else {
+        Serial.println("error opening log file");
+      }
 
         // At the very end of all processing, we clear the tline
         tline = "";
@@ -771,10 +973,87 @@ void syncData() {
 }
 
 
+/*
+ * Sends one log record during a sync as the packets loop() sent live:
+ * a frame as infoStruct, detectorStruct and irStruct,
+ * an intermediate sample as sampleStruct, a corrected frame as correctedStruct
+ */
+void sendLogRecord(logRecord_t &record) {
+  if(record.recordType == LOG_RECORD_SAMPLE) {
+    uint8_t i = record.sampleSensor;
+    if(i >= NUMBER_OF_SENSORS) {
+      return;
+    }
+    sample_packet sampleStruct;
+    sampleStruct.infoByte = 4;
+    sampleStruct.sensor = i;
+    sampleStruct.LEDpattern = record.LEDpattern;
+    sampleStruct.gainIntTime = record.gainIntTime[i];
+    sampleStruct.time = record.time;
+    sampleStruct.sensorSignal = record.sensor[i];
+    sampleStruct.irSignal = record.ir[i];
+    sampleStruct.valid = (record.validSensors >> i) & 1;
+    RFduinoBLE.send((char *)&sampleStruct, sizeof(sampleStruct));
+    return;
+  }
+  if(record.recordType == LOG_RECORD_CORRECTED) {
+    corrected_packet correctedStruct;
+    correctedStruct.infoByte = 3;
+    correctedStruct.LEDpattern = record.LEDpattern;
+    correctedStruct.validSensors = record.validSensors;
+    correctedStruct.sensor_10mm = record.corrected[0];
+    correctedStruct.sensor_20mm = record.corrected[1];
+    correctedStruct.sensor_30mm = record.corrected[2];
+    correctedStruct.sensor_40mm = record.corrected[3];
+    RFduinoBLE.send((char *)&correctedStruct, sizeof(correctedStruct));
+    return;
+  }
+  if(record.recordType != LOG_RECORD_FRAME) {
+    return;
+  }
+
+  detector_packet detectorStruct;
+  info_packet infoStruct;
+  ir_packet irStruct;
+
+  infoStruct.SDCardStatus = 0;
+  infoStruct.infoByte = 0;
+  detectorStruct.infoByte = 1;
+  irStruct.infoByte = 2;
+
+  infoStruct.time = record.time;
+  infoStruct.cellVoltage = record.cellVoltage;
+  infoStruct.stateOfCharge = record.stateOfCharge;
+  infoStruct.temp_skin = record.tempSkin;
+  infoStruct.temp_amb = record.tempAmb;
+  detectorStruct.LEDpattern = record.LEDpattern;
+  detectorStruct.validSensors = record.validSensors;
+  detectorStruct.sensor_10mm = record.sensor[0];
+  detectorStruct.sensor_20mm = record.sensor[1];
+  detectorStruct.sensor_30mm = record.sensor[2];
+  detectorStruct.sensor_40mm = record.sensor[3];
+  detectorStruct.gain_10mm = record.gainIntTime[0] >> LOG_GAIN_SHIFT;
+  detectorStruct.intTime_10mm = record.gainIntTime[0] & LOG_INT_TIME_MASK;
+  detectorStruct.gain_20mm = record.gainIntTime[1] >> LOG_GAIN_SHIFT;
+  detectorStruct.intTime_20mm = record.gainIntTime[1] & LOG_INT_TIME_MASK;
+  detectorStruct.gain_30mm = record.gainIntTime[2] >> LOG_GAIN_SHIFT;
+  detectorStruct.intTime_30mm = record.gainIntTime[2] & LOG_INT_TIME_MASK;
+  detectorStruct.gain_40mm = record.gainIntTime[3] >> LOG_GAIN_SHIFT;
+  detectorStruct.intTime_40mm = record.gainIntTime[3] & LOG_INT_TIME_MASK;
+  irStruct.ir_10mm = record.ir[0];
+  irStruct.ir_20mm = record.ir[1];
+  irStruct.ir_30mm = record.ir[2];
+  irStruct.ir_40mm = record.ir[3];
+
+  RFduinoBLE.send((char *)&infoStruct, sizeof(infoStruct));
+  RFduinoBLE.send((char *)&detectorStruct, sizeof(detectorStruct));
+  RFduinoBLE.send((char *)&irStruct, sizeof(irStruct));
+}
+
 int debounce(int state)
 {
-  int start = millis();
-  int debounce_start = start;
+  unsigned long start = millis();
+  unsigned long debounce_start = start;
 
   while (millis() - start < debounce_timeout)
     if (digitalRead(POWER_BUTTON) == state)
@@ -789,7 +1068,7 @@ int debounce(int state)
   return 0;
 }
 
-int delay_until_button(int state)
+void delay_until_button(int state)
 {
   // set button edge to wake up on
   if (state)